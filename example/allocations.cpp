@@ -0,0 +1,207 @@
+// The allocation check of betterfile, it counts the heap allocations of the common operations by replacing the
+// global operator new, and checks the data of a file is not copied more than it needs (e.g. load -> inspect -> write
+// copies the data once, by the load).
+//
+// Build:
+//   g++ -std=c++17 -O2 -pthread -I../include allocations.cpp -o allocations
+//
+// Usage:
+//   allocations [--root DIR] [--size BYTES] [--children N]
+//
+// The allocations of each check are printed, the exit code is 1 if any check failed.
+
+#include <betterfile.hpp>
+
+#include <cstdio>
+#include <cstdlib>
+#include <atomic>
+#include <new>
+#include <string>
+#include <utility>
+
+using namespace btf;
+
+// The deallocation is not inlined, else GCC warns that the memory of a new expression is released by free.
+#ifdef __GNUC__
+#define ALLOC_NOINLINE __attribute__((noinline))
+#else
+#define ALLOC_NOINLINE
+#endif // __GNUC__
+
+// The number of the heap allocations, and the number of the large ones (at least the data size of the checks),
+// the large allocations are the copies of the data.
+static std::atomic<size_t> allocations{0};
+static std::atomic<size_t> largeAllocations{0};
+static size_t largeSize = size_t(-1);
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (size >= largeSize)
+        largeAllocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+ALLOC_NOINLINE void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+ALLOC_NOINLINE void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+struct Options
+{
+    String root = pathcat(tempDirectory(), "betterfile-allocations");
+    size_t size = 1024 * 1024;      // The size of the file data.
+    size_t children = 100;          // The children of the directory looked up.
+};
+
+// The checks of the allocations, each check runs the operation and compares its allocations with the limits.
+class Checker
+{
+public:
+    // @param maxAllocations The max heap allocations of the operation.
+    // @param maxCopies The max large allocations (the copies of the data) of the operation.
+    template <typename Fn>
+    void check(const char* name, size_t maxAllocations, size_t maxCopies, Fn&& fn)
+    {
+        size_t startAllocations = allocations.load();
+        size_t startCopies = largeAllocations.load();
+
+        fn();
+
+        size_t count = allocations.load() - startAllocations;
+        size_t copies = largeAllocations.load() - startCopies;
+        bool isPassed = count <= maxAllocations && copies <= maxCopies;
+
+        std::printf("%-36s %6zu allocs (max %zu) %4zu copies (max %zu) %s\n", name, count, maxAllocations, copies,
+                    maxCopies, isPassed ? "ok" : "FAILED");
+
+        isPassed_ = isPassed_ && isPassed;
+    }
+
+    bool isPassed() const { return isPassed_; }
+
+private:
+    bool isPassed_ = true;
+};
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        String arg = argv[i];
+
+        if (i + 1 >= argc)
+            return false;
+
+        if (arg == "--root")
+            options.root = argv[++i];
+        else if (arg == "--size")
+            options.size = std::stoull(argv[++i]);
+        else if (arg == "--children")
+            options.children = std::stoull(argv[++i]);
+        else
+            return false;
+    }
+
+    return options.size > 0;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    if (!parseOptions(argc, argv, options)) {
+        std::fprintf(stderr, "Invalid arguments, see the usage at the top of allocations.cpp.\n");
+        return 2;
+    }
+
+    try {
+        deletes(options.root);
+        createDirectorys(options.root);
+
+        const String src = pathcat(options.root, "src");
+        const String dst = pathcat(options.root, "dst");
+        createDirectory(src);
+        createDirectory(dst);
+
+        String data(options.size, 'x');
+        writeFile(pathcat(src, "data"), data.data(), data.size());
+
+        // The allocations not smaller than the data are the copies of it.
+        largeSize = options.size;
+
+        Checker checker;
+        File file;
+
+        // Load -> inspect -> write, the data is only allocated by the load.
+        checker.check("File::fromDiskPath", 8, 1, [&]() { file = File::fromDiskPath(pathcat(src, "data")); });
+
+        checker.check("File::name, size, dataView", 0, 0, [&]() {
+            if (file.name() != "data" || file.size() != options.size || file.dataView()[0] != 'x')
+                std::abort();
+        });
+
+        checker.check("File::write", 4, 0, [&]() { file.write(dst, true); });
+
+        // The copy shares the data until one of them is modified.
+        checker.check("File copy", 2, 0, [&]() {
+            File copy(file);
+            if (copy.size() != file.size())
+                std::abort();
+        });
+
+        checker.check("File::takeData", 0, 0, [&]() {
+            String taken = file.takeData();
+            if (taken.size() != options.size)
+                std::abort();
+            data = std::move(taken);
+        });
+
+        // The rvalue ingestion adopts the buffer.
+        checker.check("File::operator=(String&&)", 2, 0, [&]() { file = std::move(data); });
+
+        checker.check("File::operator<<(String&&)", 2, 0, [&]() {
+            File empty("empty");
+            empty << file.takeData();
+            if (empty.size() != options.size)
+                std::abort();
+        });
+
+        // The lookups by name, the children names are compared without temporaries.
+        Dir dir("dir");
+        Strings names;
+        for (size_t i = 0; i < options.children; ++i) {
+            names.push_back("f" + std::to_string(i));
+            dir << File(names.back());
+        }
+
+        const Dir& constDir = dir;
+        checker.check("Dir::hasFile", 0, 0, [&]() {
+            for (const auto& var : names) {
+                if (!constDir.hasFile(var))
+                    std::abort();
+            }
+        });
+
+        checker.check("Dir::file", 0, 0, [&]() {
+            for (const auto& var : names)
+                dir.file(var);
+        });
+
+        largeSize = size_t(-1);
+        deletes(options.root);
+
+        return checker.isPassed() ? 0 : 1;
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+}
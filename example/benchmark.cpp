@@ -0,0 +1,958 @@
+// The benchmark suite of betterfile, it generates a deterministic synthetic tree and measures the main operations.
+// The result is printed (or written to the --output file) as JSON, so the runs can be compared by CI.
+//
+// Build:
+//   g++ -std=c++17 -O2 -pthread -I../include benchmark.cpp -o benchmark
+//
+// Usage:
+//   benchmark [--root DIR] [--files N] [--depth N] [--fanout N] [--min-size BYTES] [--max-size BYTES]
+//             [--hardlinks PERCENT] [--symlinks PERCENT] [--lookups N] [--misses N] [--repeat N] [--seed N]
+//             [--stream-size BYTES] [--threads N] [--drop-caches] [--filter NAME] [--output FILE]
+//
+// The --root decides the filesystem under test (e.g. a tmpfs mount or a directory on a real disk).
+// If --drop-caches is specified, the page cache is dropped before each repetition of the cold benchmarks
+// (it needs the permission to write /proc/sys/vm/drop_caches, else the result reports it is not dropped).
+// The directory walk is run by both backends, the native one of betterfile (getdents64) and the std::filesystem,
+// cold and warm, and on linux their system calls are counted by tracing a forked run (reported as "syscalls").
+// The tree is also loaded, written and copied by IoBackend::IO_URING, it falls back to the default backend if the
+// io_uring is not available (reported as "io_uring").
+// The parallel benchmarks are also run by 1, 2, 4, ... threads up to --threads (default the hardware concurrency),
+// so their scaling can be seen.
+
+#include <betterfile.hpp>
+
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#ifdef __linux__
+#include <csignal>      // raise
+#include <fcntl.h>      // open
+#include <unistd.h>     // sync, fork
+#include <sys/ptrace.h>
+#include <sys/vfs.h>    // statfs
+#include <sys/wait.h>
+#endif // __linux__
+
+using namespace btf;
+
+// The deallocation is not inlined, else GCC warns that the memory of a new expression is released by free.
+#ifdef __GNUC__
+#define BENCH_NOINLINE __attribute__((noinline))
+#else
+#define BENCH_NOINLINE
+#endif // __GNUC__
+
+// The number of the heap allocations, so the allocations per operation are reported.
+static std::atomic<size_t> allocations{0};
+
+void* operator new(size_t size)
+{
+    allocations.fetch_add(1, std::memory_order_relaxed);
+
+    if (void* ptr = std::malloc(size > 0 ? size : 1))
+        return ptr;
+
+    throw std::bad_alloc();
+}
+
+BENCH_NOINLINE void operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+BENCH_NOINLINE void operator delete(void* ptr, size_t) noexcept
+{
+    std::free(ptr);
+}
+
+struct Options
+{
+    String root = pathcat(tempDirectory(), "betterfile-bench");
+    size_t files = 10000;
+    size_t depth = 3;
+    size_t fanout = 4;
+    size_t minSize = 64;
+    size_t maxSize = 64 * 1024;
+    uint hardlinks = 0;         // The percent of files which are hardlinks of a previous file.
+    uint symlinks = 0;          // The percent of files which are symlinks to a previous file.
+    size_t lookups = 1000000;
+    size_t misses = 100000;     // The number of the operations on the paths which not exist.
+    size_t streamSize = 64 * 1024 * 1024;   // The size of the file read by the buffer sizes.
+    uint repeat = 5;
+    uint64_t seed = 42;
+    uint threads = 0;           // The max threads of the scaling benchmarks, 0 means the hardware concurrency.
+    bool isDropCaches = false;
+    String filter;
+    String output;
+};
+
+// The deterministic random generator (splitmix64), the result is same on all platforms and standard libraries.
+class Random
+{
+public:
+    explicit Random(uint64_t seed) : state_(seed) {}
+
+    uint64_t next()
+    {
+        uint64_t z = (state_ += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        return z ^ (z >> 31);
+    }
+
+    // @return The number in [0, bound).
+    uint64_t below(uint64_t bound) { return bound == 0 ? 0 : next() % bound; }
+
+    // @return The number in [min, max] by the log-uniform distribution (the small sizes are more common).
+    size_t logUniform(size_t min, size_t max)
+    {
+        if (min >= max)
+            return min;
+
+        double unit = static_cast<double>(next() >> 11) / static_cast<double>(1ULL << 53);
+        double value = std::exp(std::log(static_cast<double>(min) + 1) +
+                                unit * (std::log(static_cast<double>(max) + 1) - std::log(static_cast<double>(min) + 1)));
+        return std::min(max, static_cast<size_t>(value - 1));
+    }
+
+private:
+    uint64_t state_;
+};
+
+// The shape of the generated tree.
+struct Tree
+{
+    String path;
+    Strings dirs;
+    Strings files;              // The regular files (exclude the hardlinks and symlinks).
+    size_t hardlinks = 0;
+    size_t symlinks = 0;
+    size_t bytes = 0;
+};
+
+// @brief Generate the tree, the directories are a full tree of the depth and fan-out,
+// and the files are distributed to all directories in turn.
+Tree generateTree(const String& path, const Options& options)
+{
+    Random random(options.seed);
+    Tree tree;
+    tree.path = path;
+
+    deletes(path);
+    createDirectorys(path);
+
+    Strings level{path};
+    tree.dirs.push_back(path);
+
+    for (size_t d = 0; d < options.depth; ++d) {
+        Strings next;
+
+        for (const auto& parent : level) {
+            for (size_t i = 0; i < options.fanout; ++i) {
+                String dir = pathcat(parent, "d" + std::to_string(i));
+                createDirectory(dir);
+                next.push_back(dir);
+            }
+        }
+
+        tree.dirs.insert(tree.dirs.end(), next.begin(), next.end());
+        level.swap(next);
+    }
+
+    String data;
+
+    for (size_t i = 0; i < options.files; ++i) {
+        String file = pathcat(tree.dirs[i % tree.dirs.size()], "f" + std::to_string(i));
+        uint64_t kind = random.below(100);
+
+        if (!tree.files.empty() && kind < options.hardlinks) {
+            createHardlink(tree.files[random.below(tree.files.size())], file);
+            ++tree.hardlinks;
+            continue;
+        }
+
+        if (!tree.files.empty() && kind < options.hardlinks + options.symlinks) {
+            createSymlink(tree.files[random.below(tree.files.size())], file);
+            ++tree.symlinks;
+            continue;
+        }
+
+        size_t size = random.logUniform(options.minSize, options.maxSize);
+        data.resize(size);
+
+        for (size_t j = 0; j < size; j += 8) {
+            uint64_t value = random.next();
+            std::memcpy(&data[j], &value, std::min<size_t>(8, size - j));
+        }
+
+        writeFile(file, data.data(), data.size());
+        tree.files.push_back(file);
+        tree.bytes += size;
+    }
+
+    return tree;
+}
+
+// @return If the page cache is dropped return true.
+bool dropCaches()
+{
+#ifdef __linux__
+    ::sync();
+
+    std::ofstream ofs("/proc/sys/vm/drop_caches");
+    if (!ofs.is_open())
+        return false;
+
+    ofs << "3" << std::endl;
+    return static_cast<bool>(ofs);
+#else
+    return false;
+#endif // __linux__
+}
+
+String filesystemType(const String& path)
+{
+#ifdef __linux__
+    struct statfs st;
+    if (::statfs(path.c_str(), &st) != 0)
+        return "unknown";
+
+    switch (static_cast<unsigned long>(st.f_type)) {
+        case 0x01021994:
+            return "tmpfs";
+        case 0xEF53:
+            return "ext4";
+        case 0x58465342:
+            return "xfs";
+        case 0x9123683E:
+            return "btrfs";
+        case 0x794C7630:
+            return "overlayfs";
+        default:
+            return "other";
+    }
+#else
+    (void) path;
+    return "unknown";
+#endif // __linux__
+}
+
+#ifdef __linux__
+// @brief Write the tree with one fsync per file, the baseline of WriteMode::DURABLE (which flushes by groups).
+// Each file is written to a temporary sibling, flushed, renamed into place, and then its directory is flushed.
+void writeFsyncPerFile(const Dir& dir, const String& path)
+{
+    String root = pathcat(path, dir.name());
+    createDirectory(root);
+
+    auto check = [](bool isSucceeded, const String& what) {
+        if (!isSucceeded)
+            throw std::runtime_error("Failed to " + what + " (" + std::strerror(errno) + ")");
+    };
+
+    int dirFd = ::open(root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    check(dirFd >= 0, "open " + root);
+
+    for (size_t i = 0; i < dir.fileCount(false); ++i) {
+        const File& file = dir.files()[i];
+        String target = pathcat(root, file.name());
+        String temp = target + ".tmp";
+
+        int fd = ::open(temp.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+        check(fd >= 0, "open " + temp);
+
+        for (size_t done = 0; done < file.size();) {
+            ssize_t n = ::write(fd, file.cdata() + done, file.size() - done);
+            check(n > 0, "write " + temp);
+            done += static_cast<size_t>(n);
+        }
+
+        check(::fsync(fd) == 0, "fsync " + temp);
+        ::close(fd);
+
+        check(::rename(temp.c_str(), target.c_str()) == 0, "rename " + temp);
+        check(::fsync(dirFd) == 0, "fsync " + root);
+    }
+
+    ::close(dirFd);
+
+    for (size_t i = 0; i < dir.dirCount(false); ++i)
+        writeFsyncPerFile(dir.dirs()[i], root);
+}
+#endif // __linux__
+
+// @return The number of the system calls made by the function, it is run in a forked child which is traced
+// by the parent. If the platform can't trace return -1.
+// @note The function must not start threads, only the calling thread of the child is traced.
+long countSyscalls(const std::function<void()>& fn)
+{
+#ifdef __linux__
+    std::fflush(nullptr);
+
+    pid_t pid = ::fork();
+    if (pid < 0)
+        return -1;
+
+    if (pid == 0) {
+        if (::ptrace(PTRACE_TRACEME, 0, nullptr, nullptr) != 0)
+            ::_exit(1);
+
+        // Wait for the parent to set the options.
+        std::raise(SIGSTOP);
+        fn();
+        ::_exit(0);
+    }
+
+    int status = 0;
+    if (::waitpid(pid, &status, 0) != pid || !WIFSTOPPED(status)) {
+        ::waitpid(pid, &status, 0);
+        return -1;
+    }
+
+    ::ptrace(PTRACE_SETOPTIONS, pid, nullptr, reinterpret_cast<void*>(PTRACE_O_TRACESYSGOOD | PTRACE_O_EXITKILL));
+
+    // Each system call stops twice, at the entry and the exit.
+    long stops = 0;
+    while (::ptrace(PTRACE_SYSCALL, pid, nullptr, nullptr) == 0 && ::waitpid(pid, &status, 0) == pid) {
+        if (WIFEXITED(status) || WIFSIGNALED(status))
+            break;
+
+        if (WIFSTOPPED(status) && WSTOPSIG(status) == (SIGTRAP | 0x80))
+            ++stops;
+    }
+
+    // The exit_group of the child is not a call of the function, it only stops at the entry.
+    return WIFEXITED(status) && WEXITSTATUS(status) == 0 ? (stops - 1) / 2 : -1;
+#else
+    (void) fn;
+    return -1;
+#endif // __linux__
+}
+
+// The result of a benchmark.
+struct Result
+{
+    String name;
+    size_t ops = 0;             // The operations of each repetition.
+    size_t bytes = 0;           // The bytes processed of each repetition.
+    Vec<double> seconds;        // The elapsed time of each repetition.
+    Vec<double> latencies;      // The latency of each operation (seconds), or each repetition if not measured by op.
+    size_t allocations = 0;     // The heap allocations of the last repetition.
+    long syscalls = -1;         // The system calls of each repetition, -1 if not counted.
+};
+
+// @return The thread counts of the scaling benchmarks, the powers of 2 less than the max, and the max.
+Vec<uint> threadSweep(uint max)
+{
+    Vec<uint> counts;
+
+    for (uint i = 1; i < max; i *= 2)
+        counts.push_back(i);
+    counts.push_back(max);
+
+    return counts;
+}
+
+double percentile(Vec<double> values, double p)
+{
+    if (values.empty())
+        return 0.0;
+
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+}
+
+// The context of a running benchmark.
+class Bench
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit Bench(Result& result) : result_(result) {}
+
+    // @brief Measure the operation, its latency is recorded.
+    template<typename Fn>
+    void op(Fn&& fn)
+    {
+        auto start = Clock::now();
+        fn();
+        result_.latencies.push_back(std::chrono::duration<double>(Clock::now() - start).count());
+    }
+
+private:
+    Result& result_;
+};
+
+class Suite
+{
+public:
+    explicit Suite(const Options& options) : options_(options) {}
+
+    // @brief Run the benchmark by the repetitions, the setup and the teardown are not measured.
+    // @param run It measures its operations by the #Bench, if it doesn't, the whole run is an operation.
+    // @param isCold If true, the page cache is dropped (if enabled) before each repetition.
+    void run(const String& name, size_t ops, size_t bytes, const std::function<void()>& setup,
+             const std::function<void(Bench&)>& run, const std::function<void()>& teardown, bool isCold = false)
+    {
+        if (!options_.filter.empty() && name.find(options_.filter) == String::npos)
+            return;
+
+        Result result;
+        result.name = name;
+        result.ops = ops;
+        result.bytes = bytes;
+
+        for (uint i = 0; i < options_.repeat; ++i) {
+            if (setup)
+                setup();
+
+            if (isCold && options_.isDropCaches)
+                isCachesDropped_ = dropCaches() && isCachesDropped_;
+
+            size_t latencies = result.latencies.size();
+            Bench bench(result);
+
+            size_t startAllocations = allocations.load();
+            auto start = Bench::Clock::now();
+            run(bench);
+            double seconds = std::chrono::duration<double>(Bench::Clock::now() - start).count();
+            result.allocations = allocations.load() - startAllocations;
+
+            result.seconds.push_back(seconds);
+            if (result.latencies.size() == latencies)
+                result.latencies.push_back(seconds);
+
+            if (teardown)
+                teardown();
+        }
+
+        std::fprintf(stderr, "%-40s %10.3f ms %10.2f allocs/op\n", name.c_str(), percentile(result.seconds, 0.5) * 1e3,
+                     ops > 0 ? static_cast<double>(result.allocations) / ops : 0.0);
+        results_.push_back(std::move(result));
+    }
+
+    // @brief Count the system calls of the benchmark by one more (not timed) run, see #countSyscalls.
+    void countSyscalls(const String& name, const std::function<void()>& run)
+    {
+        for (auto& var : results_) {
+            if (var.name == name)
+                var.syscalls = ::countSyscalls(run);
+        }
+    }
+
+    String json(const Tree& tree) const
+    {
+        std::ostringstream os;
+        os.precision(9);
+
+        os << "{\n";
+        os << "  \"root\": \"" << escape_(options_.root) << "\",\n";
+        os << "  \"filesystem\": \"" << filesystemType(options_.root) << "\",\n";
+        os << "  \"io_uring\": " << (isIoUringAvailable() ? "true" : "false") << ",\n";
+        os << "  \"caches_dropped\": " << (options_.isDropCaches && isCachesDropped_ ? "true" : "false") << ",\n";
+        os << "  \"config\": {\"files\": " << options_.files << ", \"depth\": " << options_.depth
+           << ", \"fanout\": " << options_.fanout << ", \"min_size\": " << options_.minSize
+           << ", \"max_size\": " << options_.maxSize << ", \"stream_size\": " << options_.streamSize
+           << ", \"hardlinks\": " << options_.hardlinks
+           << ", \"symlinks\": " << options_.symlinks << ", \"repeat\": " << options_.repeat
+           << ", \"seed\": " << options_.seed << ", \"threads\": " << options_.threads << "},\n";
+        os << "  \"tree\": {\"dirs\": " << tree.dirs.size() << ", \"files\": " << tree.files.size()
+           << ", \"hardlinks\": " << tree.hardlinks << ", \"symlinks\": " << tree.symlinks
+           << ", \"bytes\": " << tree.bytes << "},\n";
+        os << "  \"benchmarks\": [\n";
+
+        for (size_t i = 0; i < results_.size(); ++i) {
+            const Result& result = results_[i];
+            double seconds = percentile(result.seconds, 0.5);
+            double allocationsPerOp = result.ops > 0 ? static_cast<double>(result.allocations) / result.ops : 0.0;
+
+            os << "    {\"name\": \"" << escape_(result.name) << "\", \"repeat\": " << result.seconds.size()
+               << ", \"ops\": " << result.ops << ", \"bytes\": " << result.bytes << ", \"seconds\": " << seconds
+               << ", \"ops_per_sec\": " << (seconds > 0 ? result.ops / seconds : 0.0)
+               << ", \"mb_per_sec\": " << (seconds > 0 ? result.bytes / seconds / 1e6 : 0.0)
+               << ", \"p50_us\": " << percentile(result.latencies, 0.5) * 1e6
+               << ", \"p99_us\": " << percentile(result.latencies, 0.99) * 1e6
+               << ", \"allocs_per_op\": " << allocationsPerOp;
+
+            if (result.syscalls >= 0)
+                os << ", \"syscalls\": " << result.syscalls;
+
+            os << "}"
+               << (i + 1 < results_.size() ? ",\n" : "\n");
+        }
+
+        os << "  ]\n";
+        os << "}\n";
+
+        return os.str();
+    }
+
+private:
+    static String escape_(const String& str)
+    {
+        String result;
+
+        for (char c : str) {
+            if (c == '"' || c == '\\')
+                result.push_back('\\');
+            result.push_back(c);
+        }
+
+        return result;
+    }
+
+    const Options& options_;
+    Vec<Result> results_;
+    bool isCachesDropped_ = true;
+};
+
+void runAll(Suite& suite, const Tree& tree, const Options& options)
+{
+    const String& src = tree.path;
+    const String dst = pathcat(options.root, "dst");
+    const String moved = pathcat(options.root, "moved");
+    size_t entries = tree.dirs.size() + options.files;
+
+    auto clean = [&]() {
+        deletes(dst);
+        deletes(moved);
+    };
+
+    clean();
+
+    // The walk reads the type of each entry and the size of each file, by the native walker (getdents64, and the
+    // children are resolved relative to the directory) or by the std::filesystem iterator of full paths.
+    struct Walk
+    {
+        const char* backend;
+        size_t (*walk)(const String&);
+    };
+
+    const Walk walks[] = {
+        {"getdents", [](const String& path) {
+            size_t bytes = 0;
+            Walker walker(path);
+            while (walker.next())
+                bytes += walker.isFile() ? walker.size() : 0;
+            return bytes;
+        }},
+        {"std::filesystem", [](const String& path) {
+            size_t bytes = 0;
+            for (const auto& var : fs::recursive_directory_iterator(path))
+                bytes += var.is_regular_file() ? static_cast<size_t>(var.file_size()) : 0;
+            return bytes;
+        }},
+    };
+
+    for (const auto& var : walks) {
+        size_t expected = var.walk(src);
+        auto walk = [&](Bench&) {
+            if (var.walk(src) != expected)
+                std::abort();
+        };
+
+        for (bool isCold : {true, false}) {
+            String name = String("walk(") + var.backend + (isCold ? ", cold)" : ", warm)");
+
+            suite.run(name, entries, 0, nullptr, walk, nullptr, isCold);
+            suite.countSyscalls(name, [&]() { var.walk(src); });
+        }
+    }
+
+    suite.run("sizes", entries, tree.bytes, nullptr, [&](Bench&) { sizes(src); }, nullptr, true);
+
+    suite.run("getAlls", entries, 0, nullptr, [&](Bench&) { getAlls(src); }, nullptr, true);
+
+    suite.run("diskUsage", entries, tree.bytes, nullptr, [&](Bench&) { diskUsage(src); }, nullptr, true);
+
+    suite.run("File::fromDiskPath", tree.files.size(), tree.bytes, nullptr, [&](Bench& bench) {
+        for (const auto& var : tree.files)
+            bench.op([&]() { File::fromDiskPath(var); });
+    }, nullptr, true);
+
+    suite.run("File::fromDiskPath(MMAP)", tree.files.size(), tree.bytes, nullptr, [&](Bench& bench) {
+        for (const auto& var : tree.files)
+            bench.op([&]() { File::fromDiskPath(var, LoadMode::MMAP).cdata(); });
+    }, nullptr, true);
+
+    suite.run("Dir::fromDiskPath", entries, tree.bytes, nullptr, [&](Bench&) { Dir::fromDiskPath(src); }, nullptr,
+              true);
+
+    suite.run("Dir::fromDiskPath(IO_URING)", entries, tree.bytes, nullptr,
+              [&](Bench&) { Dir::fromDiskPath(src, LoadMode::READ, IoBackend::IO_URING); }, nullptr, true);
+
+    // The build and the destroy of the tree in memory, the data of the files is allocated by the heap or an arena
+    // (which is released all at once), the allocations per entry are reported by the build.
+    // The nodes and the names are allocated by the heap in both, so the destroy is O(nodes) in both.
+    {
+        Dir loaded;
+        std::shared_ptr<Arena> arena;
+
+        auto load = [&](bool isArena) {
+            arena = isArena ? std::make_shared<Arena>() : nullptr;
+            loaded = isArena ? Dir::fromDiskPath(src, arena) : Dir::fromDiskPath(src);
+        };
+
+        auto release = [&]() {
+            loaded = Dir();
+            arena.reset();
+        };
+
+        for (bool isArena : {false, true}) {
+            String suffix = isArena ? "(arena)" : "";
+
+            suite.run("Dir::build" + suffix, entries, tree.bytes, release, [&](Bench&) { load(isArena); }, release);
+
+            suite.run("Dir::destroy" + suffix, entries, tree.bytes, [&]() { load(isArena); },
+                      [&](Bench&) { release(); }, nullptr);
+        }
+    }
+
+    suite.run("Dir::parallelFromDiskPath", entries, tree.bytes, nullptr,
+              [&](Bench&) { Dir::parallelFromDiskPath(src); }, nullptr, true);
+
+    for (uint threads : threadSweep(options.threads)) {
+        suite.run("Dir::parallelFromDiskPath(threads=" + std::to_string(threads) + ")", entries, tree.bytes, nullptr,
+                  [&](Bench&) { Dir::parallelFromDiskPath(src, threads); }, nullptr, true);
+    }
+
+    {
+        // The tree is written into the destination directory.
+        Dir dir = Dir::fromDiskPath(src);
+        auto prepare = [&]() {
+            clean();
+            createDirectorys(dst);
+        };
+
+        suite.run("Dir::write", entries, tree.bytes, prepare, [&](Bench&) { dir.write(dst); }, clean);
+
+        suite.run("Dir::write(IO_URING)", entries, tree.bytes, prepare,
+                  [&](Bench&) { dir.write(dst, false, std::ios_base::binary, IoBackend::IO_URING); }, clean);
+
+        suite.run("Dir::write(DURABLE)", entries, tree.bytes, prepare,
+                  [&](Bench&) { dir.write(dst, false, WriteMode::DURABLE); }, clean);
+
+#ifdef __linux__
+        suite.run("Dir::write(fsync per file)", entries, tree.bytes, prepare,
+                  [&](Bench&) { writeFsyncPerFile(dir, dst); }, clean);
+#endif // __linux__
+    }
+
+    suite.run("copy", entries, tree.bytes, clean, [&](Bench&) { copy(src, dst); }, clean, true);
+
+    suite.run("copy(IO_URING)", entries, tree.bytes, clean, [&](Bench&) { copy(src, dst, false, IoBackend::IO_URING); },
+              clean, true);
+
+    suite.run("parallelCopy", entries, tree.bytes, clean, [&](Bench&) { parallelCopy(src, dst); }, clean, true);
+
+    suite.run("move", entries, tree.bytes, [&]() {
+        clean();
+        copy(src, dst);
+    }, [&](Bench&) { move(dst, moved); }, clean);
+
+    suite.run("move(merge)", entries, tree.bytes, [&]() {
+        clean();
+        copy(src, dst);
+        createDirectorys(moved);
+        writeFile(pathcat(moved, "existing"), "", 0);
+    }, [&](Bench&) { move(dst, moved); }, clean);
+
+    suite.run("deletes", entries, 0, [&]() {
+        clean();
+        copy(src, dst);
+    }, [&](Bench&) { deletes(dst); }, clean);
+
+    // The streaming read of a large file by the buffer sizes, from a std::istream and from a file descriptor.
+    if (options.streamSize > 0) {
+        const String stream = pathcat(options.root, "stream");
+        size_t size = options.streamSize;
+
+        {
+            Random random(options.seed);
+            String data(size, '\0');
+            for (size_t i = 0; i < size; i += 8) {
+                uint64_t value = random.next();
+                std::memcpy(&data[i], &value, std::min<size_t>(8, size - i));
+            }
+
+            writeFile(stream, data.data(), data.size());
+        }
+
+        for (size_t bufferSize : {size_t(4) * 1024, size_t(64) * 1024, size_t(1024) * 1024}) {
+            String label = "buffer=" + std::to_string(bufferSize / 1024) + "K";
+
+            suite.run("File::read(istream, " + label + ")", 1, size, nullptr, [&](Bench&) {
+                std::ifstream ifs(stream, std::ios_base::binary);
+                File file("stream");
+                file.read(ifs, bufferSize);
+
+                if (file.size() != size)
+                    std::abort();
+            }, nullptr, true);
+
+#ifdef __linux__
+            suite.run("File::read(fd, " + label + ")", 1, size, nullptr, [&](Bench&) {
+                int fd = ::open(stream.c_str(), O_RDONLY | O_CLOEXEC);
+                File file("stream");
+                file.read(fd, bufferSize);
+                ::close(fd);
+
+                if (file.size() != size)
+                    std::abort();
+            }, nullptr, true);
+#endif // __linux__
+        }
+
+        suite.run("File::fromDiskPath(DIRECT)", 1, size, nullptr, [&](Bench&) {
+            if (File::fromDiskPath(stream, LoadMode::DIRECT).size() != size)
+                std::abort();
+        }, nullptr, true);
+
+        deletes(stream);
+    }
+
+    // The lookups of a flat directory in memory, the names are looked up in a deterministic random order.
+    {
+        size_t count = std::max<size_t>(1, options.files);
+        Dir dir("lookup");
+        Strings names;
+
+        for (size_t i = 0; i < count; ++i) {
+            names.push_back("f" + std::to_string(i));
+            dir << File(names.back());
+        }
+
+        Random random(options.seed);
+        Vec<size_t> order(options.lookups);
+        for (auto& var : order)
+            var = random.below(count);
+
+        suite.run("Dir::hasFile", order.size(), 0, nullptr, [&](Bench&) {
+            size_t found = 0;
+            for (auto var : order)
+                found += dir.hasFile(names[var]) ? 1 : 0;
+
+            if (found != order.size())
+                std::abort();
+        }, nullptr);
+
+        suite.run("Dir::file", order.size(), 0, nullptr, [&](Bench&) {
+            for (auto var : order)
+                dir.file(names[var]);
+        }, nullptr);
+    }
+
+    // The path building in memory, the destinations of the tree files are built as a copy of the tree does.
+    if (!tree.files.empty()) {
+        const Strings& files = tree.files;
+        size_t count = options.lookups;
+        size_t expected = 0;
+
+        for (size_t i = 0; i < count; ++i)
+            expected += dst.size() + files[i % files.size()].size() - src.size();
+
+        suite.run("pathcat(substr)", count, 0, nullptr, [&](Bench&) {
+            size_t total = 0;
+            for (size_t i = 0; i < count; ++i) {
+                const String& var = files[i % files.size()];
+                total += pathcat(dst, var.substr(src.size() + 1)).size();
+            }
+
+            if (total != expected)
+                std::abort();
+        }, nullptr);
+
+        suite.run("PathBuilder::join", count, 0, nullptr, [&](Bench&) {
+            size_t total = 0;
+            PathBuilder builder(dst);
+            for (size_t i = 0; i < count; ++i)
+                total += builder.join(files[i % files.size()], src.size()).size();
+
+            if (total != expected)
+                std::abort();
+        }, nullptr);
+
+        suite.run("pathcat(variadic)", count, 0, nullptr, [&](Bench&) {
+            size_t total = 0;
+            for (size_t i = 0; i < count; ++i)
+                total += pathcat(dst, "d0", "d1", files[i % files.size()]).size();
+
+            if (total == 0)
+                std::abort();
+        }, nullptr);
+
+        suite.run("isSubPath", count, 0, nullptr, [&](Bench&) {
+            for (size_t i = 0; i < count; ++i) {
+                if (!isSubPath(files[i % files.size()], src))
+                    std::abort();
+            }
+        }, nullptr);
+
+        suite.run("isEqualPath", count, 0, nullptr, [&](Bench&) {
+            for (size_t i = 0; i < count; ++i) {
+                if (isEqualPath(files[i % files.size()], dst))
+                    std::abort();
+            }
+        }, nullptr);
+    }
+
+    // The operations on the paths which not exist (e.g. a bulk job of a stale path list),
+    // the failures are caught from the throwing overloads or reported by the std::error_code overloads.
+    {
+        Strings missing;
+        for (size_t i = 0; i < options.misses; ++i)
+            missing.push_back(pathcat(src, "missing" + std::to_string(i)));
+
+        String to = pathcat(dst, "missing");
+
+        suite.run("sizes(missing)", missing.size(), 0, nullptr, [&](Bench&) {
+            for (const auto& var : missing) {
+                try {
+                    sizes(var);
+                } catch (const Exception&) {}
+            }
+        }, nullptr);
+
+        suite.run("sizes(missing, ec)", missing.size(), 0, nullptr, [&](Bench&) {
+            std::error_code ec;
+            for (const auto& var : missing)
+                sizes(var, ec);
+        }, nullptr);
+
+        suite.run("copy(missing)", missing.size(), 0, nullptr, [&](Bench&) {
+            for (const auto& var : missing) {
+                try {
+                    copy(var, to);
+                } catch (const Exception&) {}
+            }
+        }, nullptr);
+
+        suite.run("copy(missing, ec)", missing.size(), 0, nullptr, [&](Bench&) {
+            std::error_code ec;
+            for (const auto& var : missing)
+                copy(var, to, false, ec);
+        }, nullptr);
+
+        suite.run("getAlls(missing)", missing.size(), 0, nullptr, [&](Bench&) {
+            for (const auto& var : missing) {
+                try {
+                    getAlls(var);
+                } catch (const Exception&) {}
+            }
+        }, nullptr);
+
+        suite.run("getAlls(missing, ec)", missing.size(), 0, nullptr, [&](Bench&) {
+            std::error_code ec;
+            for (const auto& var : missing)
+                getAlls(var, true, nullptr, ec);
+        }, nullptr);
+    }
+
+    clean();
+}
+
+bool parseOptions(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        String arg = argv[i];
+        auto value = [&]() -> String {
+            if (i + 1 >= argc)
+                throw std::runtime_error("Missing the value of " + arg);
+            return argv[++i];
+        };
+
+        if (arg == "--root")
+            options.root = value();
+        else if (arg == "--files")
+            options.files = std::stoull(value());
+        else if (arg == "--depth")
+            options.depth = std::stoull(value());
+        else if (arg == "--fanout")
+            options.fanout = std::stoull(value());
+        else if (arg == "--min-size")
+            options.minSize = std::stoull(value());
+        else if (arg == "--max-size")
+            options.maxSize = std::stoull(value());
+        else if (arg == "--hardlinks")
+            options.hardlinks = static_cast<uint>(std::stoul(value()));
+        else if (arg == "--symlinks")
+            options.symlinks = static_cast<uint>(std::stoul(value()));
+        else if (arg == "--lookups")
+            options.lookups = std::stoull(value());
+        else if (arg == "--misses")
+            options.misses = std::stoull(value());
+        else if (arg == "--repeat")
+            options.repeat = static_cast<uint>(std::stoul(value()));
+        else if (arg == "--seed")
+            options.seed = std::stoull(value());
+        else if (arg == "--stream-size")
+            options.streamSize = std::stoull(value());
+        else if (arg == "--threads")
+            options.threads = static_cast<uint>(std::stoul(value()));
+        else if (arg == "--drop-caches")
+            options.isDropCaches = true;
+        else if (arg == "--filter")
+            options.filter = value();
+        else if (arg == "--output")
+            options.output = value();
+        else
+            return false;
+    }
+
+    if (options.threads == 0)
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+
+    return options.repeat > 0 && options.minSize <= options.maxSize && options.hardlinks + options.symlinks <= 100;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+
+    try {
+        if (!parseOptions(argc, argv, options)) {
+            std::fprintf(stderr, "Invalid arguments, see the usage at the top of benchmark.cpp.\n");
+            return 2;
+        }
+
+        createDirectorys(options.root);
+
+        Tree tree = generateTree(pathcat(options.root, "src"), options);
+        Suite suite(options);
+
+        runAll(suite, tree, options);
+
+        String json = suite.json(tree);
+
+        if (options.output.empty()) {
+            std::cout << json;
+        } else {
+            std::ofstream ofs(options.output);
+            ofs << json;
+        }
+
+        deletes(options.root);
+    } catch (const std::exception& e) {
+        std::fprintf(stderr, "%s\n", e.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -39,17 +39,41 @@
 // #define BTF_FWD
 // #include <betterfile.hpp>
 //
+// 4. Define BTF_INSTRUMENT (in all the files which include this library) to count the system calls, the bytes
+// and the entries of each public function and keep their latency histograms, see #instrumentSnapshot.
+// If it is not defined, the instrumentation is not compiled.
+//
 
 #ifndef BETTERFILE_HPP
 #define BETTERFILE_HPP
 
 #include <cstddef>  // size_t
+#include <cstdint>  // uint64_t
+#include <cstring>  // memcpy, strerror, strlen
+#include <cerrno>   // errno
 #include <string>
 #include <vector>
 #include <iostream>
 #include <sstream>  // stringstream
 #include <fstream>
 #include <stdexcept>
+#include <algorithm>  // min, max
+#include <memory>   // unique_ptr
+#include <new>      // placement new
+#include <deque>
+#include <functional>
+#include <exception>  // exception_ptr
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+#include <chrono>
+#include <type_traits>  // is_void
+#include <utility>      // declval, forward, pair
+#include <map>
+#include <unordered_set>
+#include <system_error>  // error_code, error_category
 
 // Compiler version.
 #ifdef _MSVC_LANG
@@ -67,6 +91,54 @@
 #define _BETTERFILE_CPP17
 #endif // BETTERFILE_CPPVERS >= 201703L
 
+// Check platform, the linux has the native fast paths (e.g. kernel-side copy).
+#ifdef _BETTERFILE_CPP17
+#include <string_view>
+#endif // _BETTERFILE_CPP17
+
+#ifdef __linux__
+#define _BETTERFILE_LINUX
+#endif // __linux__
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define _BETTERFILE_X86_64
+#include <immintrin.h>  // SSE2, AVX2
+// The AVX2 kernels are compiled by the target attribute and selected at runtime.
+#if defined(__GNUC__) || defined(__clang__)
+#define _BETTERFILE_AVX2
+#endif // defined(__GNUC__) || defined(__clang__)
+#endif // defined(__x86_64__) || defined(_M_X64)
+
+#ifdef _BETTERFILE_LINUX
+#include <cerrno>
+#include <cstdlib>      // posix_memalign
+#include <fcntl.h>      // open
+#include <unistd.h>     // read, write, close, copy_file_range
+#include <sys/stat.h>   // fstat
+#include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/mman.h>     // mmap
+#include <dirent.h>       // DT_REG, DT_DIR...
+#include <sys/syscall.h>  // SYS_getdents64
+#ifndef FICLONE
+#define FICLONE _IOW(0x94, 9, int)
+#endif // !FICLONE
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif // !RENAME_NOREPLACE
+
+// The io_uring backend needs the Linux 5.6+ headers, define BTF_NO_IO_URING to disable it.
+#if !defined(BTF_NO_IO_URING) && defined(__has_include) && defined(SYS_io_uring_setup)
+#if __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/uio.h>      // iovec
+#ifdef IORING_FEAT_RW_CUR_POS
+#define _BETTERFILE_IO_URING
+#endif // IORING_FEAT_RW_CUR_POS
+#endif // __has_include(<linux/io_uring.h>)
+#endif // !defined(BTF_NO_IO_URING) && defined(__has_include) && defined(SYS_io_uring_setup)
+#endif // _BETTERFILE_LINUX
+
 #ifdef BTF_IMPL
 #define BTF_API 
 #else
@@ -98,7 +170,48 @@ using String = std::string;
 using Strings = Vec<String>;
 using Exception = std::runtime_error;
 
+#ifdef _BETTERFILE_CPP17
+using StringView = std::string_view;
+#else
+// @brief The non-owning view of a contiguous characters (the subset of std::string_view).
+class StringView
+{
+public:
+    StringView() = default;
+
+    StringView(const char* data, size_t size) : data_(data), size_(size) {}
+
+    StringView(const String& str) : data_(str.data()), size_(str.size()) {}
+
+    const char* data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    bool empty() const { return size_ == 0; }
+
+    const char* begin() const { return data_; }
+
+    const char* end() const { return data_ + size_; }
+
+    char operator[](size_t pos) const { return data_[pos]; }
+
+    explicit operator String() const { return String(data_, size_); }
+
+    bool operator==(StringView other) const
+    {
+        return size_ == other.size_ && (size_ == 0 || std::char_traits<char>::compare(data_, other.data_, size_) == 0);
+    }
+
+    bool operator!=(StringView other) const { return !(*this == other); }
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+#endif // _BETTERFILE_CPP17
+
 constexpr uint _BUFFER_SIZE = 4096;
+constexpr uint _LARGE_BUFFER_SIZE = 128 * 1024;
 
 // Preferred path separator.
 constexpr char WIN_PATH_SEPARATOR = '\\';
@@ -112,28 +225,259 @@ constexpr char PREFERRED_PATH_SEPARATOR = LINUX_PATH_SEPARATOR;
 // The invalid characters in filename.
 constexpr const char* FILENAME_INVALID_CHARS = "\\/:*?\"<>|";
 
+// The mode to load the data of a file from disk.
+enum class LoadMode
+{
+    READ,               // Read the data into an owned buffer.
+    MMAP,               // Map the file read-only, the data is copied to an owned buffer only when modified.
+    MMAP_POPULATE,      // Same as MMAP, and prefault the pages of the file (MAP_POPULATE).
+    MMAP_SEQUENTIAL,    // Same as MMAP, and hint the kernel to read ahead for sequential access.
+    DIRECT,             // Read by O_DIRECT which bypasses the page cache, for the huge files read once.
+    LAZY                // Only record the size and the path, the data is read when it is accessed first.
+};
+
+// The type of a filesystem entry.
+enum class EntryType
+{
+    NONE,               // Not exists (e.g. the target of a broken symlink).
+    FILE,               // Regular file.
+    DIRECTORY,
+    OTHER               // Other types (e.g. socket, fifo, device).
+};
+
+// The action returned by the visitor of #walk.
+enum class WalkAction
+{
+    CONTINUE,           // Continue the walk.
+    SKIP,               // Don't descend into the current directory.
+    STOP                // Stop the walk.
+};
+
+// The strategy used to copy the data of a file.
+enum class CopyStrategy
+{
+    NONE,               // Not copied (e.g. skipped because the destination exists).
+    REFLINK,            // Cloned by FICLONE, the data blocks are shared by the filesystem until written.
+    COPY_FILE_RANGE,    // Copied in kernel by copy_file_range.
+    SENDFILE,           // Copied in kernel by sendfile.
+    BUFFERED,           // Copied by a user-space read/write loop.
+    FILESYSTEM          // Copied by the std::filesystem (the platform has no native fast path).
+};
+
+constexpr uint COPY_STRATEGY_COUNT = 6;
+
+// The backend of the file I/O of the whole directory tree.
+enum class IoBackend
+{
+    DEFAULT,            // The synchronous system calls (or the std streams).
+    IO_URING            // The io_uring of Linux 5.6+, the operations of many files are submitted in batches.
+                        // If not available (see #isIoUringAvailable), fallback to DEFAULT.
+};
+
+// The durability of writing a file or directory tree.
+enum class WriteMode
+{
+    DEFAULT,            // Create or truncate the file and write it in place.
+    ATOMIC,             // Write to a temporary sibling and rename it into place, a file is never seen torn.
+                        // The mode and the owner (if permitted) of an existing file are kept,
+                        // but its other hard links still refer to the old data.
+    DURABLE             // Same as ATOMIC, and the data and the renames are flushed to disk before return
+                        // (the files are flushed by groups, see #_commitWrites).
+};
+
+// The errors of betterfile, they are the std::error_code of #errorCategory.
+// The errors which have the std equivalent (e.g. PATH_NOT_EXISTS) compare equal to it.
+enum class Errc
+{
+    PATH_NOT_EXISTS = 1,        // The specified path not exists.
+    SOURCE_NOT_EXISTS,          // The specified source path not exists.
+    SOURCE_NOT_FILE,            // The specified source path is not file or not exists.
+    NOT_DIRECTORY,              // The specified path is not directory or not exists.
+    DESTINATION_IS_FILE,        // The destination path contains same name file.
+    DESTINATION_IS_DIRECTORY,   // The destination path contains same name directory.
+    COPY_TO_SUBDIRECTORY,       // Can't copy directory to a subdirectory.
+    MOVE_TO_SUBDIRECTORY,       // Can't move directory to a subdirectory.
+    HARDLINK_DIRECTORY          // Can't hardlink for directory.
+};
+
+// The disk usage of a file or directory tree.
+struct DiskUsage
+{
+    size_t files = 0;           // The number of regular files (the hardlinks of a file are counted once).
+    size_t dirs = 0;            // The number of subdirectories.
+    size_t apparentSize = 0;    // The sum of the sizes of regular files.
+    size_t allocatedSize = 0;   // The sum of the allocated blocks of regular files and directories (include itself).
+};
+
+// The statistics of a copy operation.
+struct CopyStats
+{
+    size_t files = 0;           // The number of files copied.
+    size_t skippedFiles = 0;    // The number of files skipped because the destination exists.
+    size_t dirs = 0;            // The number of directories created or visited.
+    size_t bytes = 0;           // The number of bytes copied.
+    double seconds = 0.0;       // The elapsed wall time.
+
+    // The number of files copied by each strategy, indexed by #CopyStrategy.
+    size_t strategyCounts[COPY_STRATEGY_COUNT] = {};
+
+    // @return The bytes copied per second.
+    double throughput() const { return seconds > 0.0 ? bytes / seconds : 0.0; }
+};
+
+// The callback called with the source path and the strategy of each file copied,
+// the strategy of the file skipped is CopyStrategy::NONE.
+using CopyCallback = std::function<void(const String& src, CopyStrategy strategy)>;
+
+// The options of #mirror.
+struct SyncOptions
+{
+    // If true, the files of same size but different mtime are compared by the content hash (the files of same
+    // size and same mtime are unchanged without hashing), else they are compared by the mtime only.
+    bool isCompareHash = false;
+    // If true, the entries of destination which not exist in the source are deleted.
+    bool isDeleteExtras = false;
+    // If true, the mtime of source is set to the copied file (and the skipped file if its mtime is different),
+    // so the next mirror can skip it by the mtime. If false, the mtime of destination is not changed, the files of
+    // same size and same mtime are still skipped, but a copied file has a new mtime, so the next mirror copies it
+    // again unless it is compared by hash (see #isCompareHash).
+    bool isPreserveMtime = true;
+};
+
+// The statistics of a mirror operation.
+struct SyncStats
+{
+    size_t copiedFiles = 0;     // The number of files copied (new or changed).
+    size_t copiedBytes = 0;
+    size_t skippedFiles = 0;    // The number of files skipped because they are unchanged.
+    size_t skippedBytes = 0;
+    size_t deletedFiles = 0;    // The number of files of destination deleted (include the files in deleted directories).
+    size_t deletedDirs = 0;
+    size_t deletedBytes = 0;
+    size_t dirs = 0;            // The number of directories created or visited.
+    double seconds = 0.0;       // The elapsed wall time.
+};
+
 } // namespace btf
 
+namespace std
+{
+
+// The #btf::Errc is implicitly converted to std::error_code.
+template <>
+struct is_error_code_enum<btf::Errc> : true_type {};
+
+} // namespace std
+
 // Utility functions with not filesystem.
 namespace btf
 {
 
+inline size_t _pathSize(const String& path) { return path.size(); }
+
+inline size_t _pathSize(const char* path) { return std::strlen(path); }
+
+// @return The size of the separators and the paths to append.
+inline size_t _pathcatSize() { return 0; }
+
+template <typename T, typename... Args>
+size_t _pathcatSize(const T& path, const Args&... paths)
+{
+    return 1 + _pathSize(path) + _pathcatSize(paths...);
+}
+
+inline void _pathcatAppend(String&) {}
+
+template <typename T, typename... Args>
+void _pathcatAppend(String& out, const T& path, const Args&... paths)
+{
+    out += PREFERRED_PATH_SEPARATOR;
+    out += path;
+    _pathcatAppend(out, paths...);
+}
+
 // @brief Concatenate two paths.
 inline String pathcat(const String& path1, const String& path2)
 {
-    return path1 + PREFERRED_PATH_SEPARATOR + path2;
+    String path;
+    path.reserve(path1.size() + 1 + path2.size());
+    path += path1;
+    path += PREFERRED_PATH_SEPARATOR;
+    path += path2;
+
+    return path;
 }
 
-// @brief Concatenate multiple paths.
+// @brief Concatenate multiple paths, the total size is computed first so the result is allocated once.
 template <typename... Args>
-String pathcat(const String& path1, const String& path2, Args&&... paths)
+String pathcat(const String& path1, const String& path2, const Args&... paths)
 {
-    if (sizeof...(paths) == 0)
-        return pathcat(path1, path2);
-    else
-        return pathcat(pathcat(path1, path2), std::forward<Args>(paths)...);
+    String path;
+    path.reserve(path1.size() + _pathcatSize(path2, paths...));
+    path += path1;
+    _pathcatAppend(path, path2, paths...);
+
+    return path;
 }
 
+// @brief The builder of the paths under a base path. Its buffer is reused, so once the buffer is big enough
+// the paths are built without allocation (e.g. the destinations of the entries of a walk).
+//
+// @example
+// PathBuilder target(dst);
+// for (const auto& var : Walker(src))
+//     std::cout << target.join(var.path(), src.size()) << std::endl;
+class PathBuilder
+{
+public:
+    explicit PathBuilder(const String& base = String()) : path_(base), baseSize_(base.size()) {}
+
+    // @brief Change the base path, the buffer is kept.
+    void reset(const String& base)
+    {
+        path_.assign(base);
+        baseSize_ = base.size();
+    }
+
+    // @brief Build the path of the base and the relative path, the leading separators of it are skipped.
+    // @return The path, it is valid until the builder is changed. If the relative path is empty return the base.
+    const String& join(const char* relative, size_t size)
+    {
+        while (size > 0 && (*relative == WIN_PATH_SEPARATOR || *relative == LINUX_PATH_SEPARATOR)) {
+            ++relative;
+            --size;
+        }
+
+        path_.resize(baseSize_);
+
+        if (size > 0) {
+            if (!path_.empty() && path_.back() != WIN_PATH_SEPARATOR && path_.back() != LINUX_PATH_SEPARATOR)
+                path_.push_back(PREFERRED_PATH_SEPARATOR);
+
+            path_.append(relative, size);
+        }
+
+        return path_;
+    }
+
+    const String& join(const String& relative) { return join(relative.data(), relative.size()); }
+
+    // @brief Same as join(path.substr(offset)) but the substring is not copied,
+    // e.g. the path of a walked entry and the size of the walked root.
+    const String& join(const String& path, size_t offset)
+    {
+        offset = std::min(offset, path.size());
+        return join(path.data() + offset, path.size() - offset);
+    }
+
+    // @return The path built last, or the base.
+    const String& path() const { return path_; }
+
+private:
+    String path_;
+    size_t baseSize_;
+};
+
 // @brief Check if the filename is valid.
 inline bool isValidFilename(const String& filename)
 {
@@ -241,770 +585,7266 @@ String _fmt(const String& fmt, const T& arg, Args&&... args)
     return ss.str();
 }
 
-} // namespace btf
+// The category of #Errc, the message is only formatted when it is asked for.
+class _ErrorCategory : public std::error_category
+{
+public:
+    const char* name() const noexcept override { return "btf"; }
 
-#ifdef _BETTERFILE_CPP17
-#ifndef BTF_FWD
-#include <filesystem>
-namespace btf
+    String message(int ev) const override
+    {
+        switch (static_cast<Errc>(ev)) {
+            case Errc::PATH_NOT_EXISTS:             return "The specified path not exists.";
+            case Errc::SOURCE_NOT_EXISTS:           return "The specified source path not exists.";
+            case Errc::SOURCE_NOT_FILE:             return "The specified source path is not file or not exists.";
+            case Errc::NOT_DIRECTORY:               return "The specified path is not directory or not exists.";
+            case Errc::DESTINATION_IS_FILE:         return "The destination path contains same name file.";
+            case Errc::DESTINATION_IS_DIRECTORY:    return "The destination path contains same name directory.";
+            case Errc::COPY_TO_SUBDIRECTORY:        return "Can't copy directory to a subdirectory.";
+            case Errc::MOVE_TO_SUBDIRECTORY:        return "Can't move directory to a subdirectory.";
+            case Errc::HARDLINK_DIRECTORY:          return "Can't hardlink for directory.";
+            default:                                return "Unknown error.";
+        }
+    }
+
+    std::error_condition default_error_condition(int ev) const noexcept override
+    {
+        switch (static_cast<Errc>(ev)) {
+            case Errc::PATH_NOT_EXISTS:
+            case Errc::SOURCE_NOT_EXISTS:           return std::errc::no_such_file_or_directory;
+            case Errc::NOT_DIRECTORY:               return std::errc::not_a_directory;
+            case Errc::DESTINATION_IS_FILE:         return std::errc::file_exists;
+            case Errc::DESTINATION_IS_DIRECTORY:    return std::errc::is_a_directory;
+            case Errc::COPY_TO_SUBDIRECTORY:
+            case Errc::MOVE_TO_SUBDIRECTORY:        return std::errc::invalid_argument;
+            case Errc::HARDLINK_DIRECTORY:          return std::errc::operation_not_permitted;
+            default:                                return std::error_condition(ev, *this);
+        }
+    }
+};
+
+// @return The category of the errors of betterfile.
+inline const std::error_category& errorCategory() noexcept
 {
+    static const _ErrorCategory category;
+    return category;
+}
 
-namespace fs = std::filesystem;
+inline std::error_code make_error_code(Errc e) noexcept
+{
+    return std::error_code(static_cast<int>(e), errorCategory());
+}
 
+// @return The error code of the current errno.
+inline std::error_code _lastError() noexcept
+{
+    return std::error_code(errno, std::generic_category());
 }
-#endif // !BTF_FWD
-#else
-#ifndef BTF_FWD
-#include <ghc/filesystem.hpp>
-namespace btf
+
+// @brief The #Exception with the error code, the failure thrown by the deep of an operation
+// can be reported by its non-throwing overload.
+class _SystemError : public std::system_error
 {
+public:
+    _SystemError(const std::error_code& code, const String& message) : std::system_error(code), message_(message) {}
 
-namespace fs = ghc::filesystem;
+    const char* what() const noexcept override { return message_.what(); }
 
+private:
+    std::runtime_error message_;    // Not use String, the copy of exception should not throw.
+};
+
+// @brief Throw the error if it is not empty, the message is formatted here (not where the error is reported).
+inline void _throwIf(const std::error_code& ec, const String& path)
+{
+    if (ec)
+        throw _SystemError(ec, _fmt("{} \"{}\"", ec.message(), path));
 }
-#endif // !BTF_FWD
-#endif // _BETTERFILE_CPP17
 
-// Declaration of utility functions with filesystem.
-namespace btf
+// @brief Same as above, the destination is shown if the error is between the source and destination.
+inline void _throwIf(const std::error_code& ec, const String& src, const String& dst)
 {
+    if (!ec)
+        return;
 
-#ifndef BTF_IMPL
+    if (ec == Errc::DESTINATION_IS_FILE || ec == Errc::DESTINATION_IS_DIRECTORY ||
+        ec == Errc::COPY_TO_SUBDIRECTORY || ec == Errc::MOVE_TO_SUBDIRECTORY)
+        throw _SystemError(ec, _fmt("{} \"{}\" -> \"{}\"", ec.message(), src, dst));
 
-BTF_API String normalize(const String& path);
+    _throwIf(ec, src);
+}
 
-BTF_API String currentPath();
+// @return The error code of the exception which is being handled, it must be called in a catch block.
+inline std::error_code _currentError() noexcept
+{
+    try {
+        throw;
+    } catch (const std::system_error& e) {
+        return e.code();
+    } catch (const std::bad_alloc&) {
+        return std::make_error_code(std::errc::not_enough_memory);
+    } catch (...) {
+        return std::make_error_code(std::errc::io_error);
+    }
+}
 
-// @example "C:/path/to/file.txt" -> "C:/path/to"
-BTF_API String parentPath(const String& path);
+// @brief The 64-bit hash of XXH64, it is used as the checksum of the data.
+inline uint64_t _xxh64(const void* data, size_t size, uint64_t seed = 0)
+{
+    constexpr uint64_t P1 = 11400714785074694791ULL;
+    constexpr uint64_t P2 = 14029467366897019727ULL;
+    constexpr uint64_t P3 = 1609587929392839161ULL;
+    constexpr uint64_t P4 = 9650029242287828579ULL;
+    constexpr uint64_t P5 = 2870177450012600261ULL;
 
-// @example "C:/path/to/file.txt" -> "to"
-BTF_API String parentName(const String& path);
+    struct Ops
+    {
+        static uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
 
-// @example "C:/path/to/file.txt" -> "file.txt"
-BTF_API String filenameEx(const String& path);
+        static uint64_t read64(const unsigned char* p)
+        {
+            uint64_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
 
-// @example "C:/path/to/file.txt" -> "file"
-BTF_API String filename(const String& path);
+        static uint32_t read32(const unsigned char* p)
+        {
+            uint32_t v;
+            std::memcpy(&v, p, sizeof(v));
+            return v;
+        }
 
-// @example "C:/path/to/file.txt" -> ".txt"
-BTF_API String extension(const String& path);
+        static uint64_t round(uint64_t acc, uint64_t input) { return rotl(acc + input * P2, 31) * P1; }
 
-BTF_API bool isExists(const String& path);
+        static uint64_t merge(uint64_t acc, uint64_t v) { return (acc ^ round(0, v)) * P1 + P4; }
+    };
 
-// @return If the path is exists and path target is a regular file return true, else return false.
-BTF_API bool isFile(const String& path);
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    uint64_t h;
 
-// @return If the path is exists and path target is a directory return true, else return false.
-BTF_API bool isDirectory(const String& path);
+    if (size >= 32) {
+        uint64_t v1 = seed + P1 + P2;
+        uint64_t v2 = seed + P2;
+        uint64_t v3 = seed;
+        uint64_t v4 = seed - P1;
 
-// @return If the path is exists and path target is a symlink return true, else return false.
-BTF_API bool isSymlink(const String& path);
+        for (; p + 32 <= end; p += 32) {
+            v1 = Ops::round(v1, Ops::read64(p));
+            v2 = Ops::round(v2, Ops::read64(p + 8));
+            v3 = Ops::round(v3, Ops::read64(p + 16));
+            v4 = Ops::round(v4, Ops::read64(p + 24));
+        }
 
-// @return If the path is a empty file or directory return true, else return false.
-// @note If the path is not exists, throw exception.
-BTF_API bool isEmpty(const String& path);
+        h = Ops::rotl(v1, 1) + Ops::rotl(v2, 7) + Ops::rotl(v3, 12) + Ops::rotl(v4, 18);
+        h = Ops::merge(h, v1);
+        h = Ops::merge(h, v2);
+        h = Ops::merge(h, v3);
+        h = Ops::merge(h, v4);
+    } else {
+        h = seed + P5;
+    }
 
-BTF_API bool isSubPath(const String& path, const String& base);
+    h += static_cast<uint64_t>(size);
 
-BTF_API bool isRelative(const String& path);
+    for (; p + 8 <= end; p += 8)
+        h = Ops::rotl(h ^ Ops::round(0, Ops::read64(p)), 27) * P1 + P4;
 
-BTF_API bool isAbsolute(const String& path);
+    if (p + 4 <= end) {
+        h = Ops::rotl(h ^ (Ops::read32(p) * P1), 23) * P2 + P3;
+        p += 4;
+    }
 
-// @brief Get the relative path from the base path.
-BTF_API String relative(const String& path, const String& base = currentPath());
+    for (; p < end; ++p)
+        h = Ops::rotl(h ^ (*p * P5), 11) * P1;
 
-BTF_API String absolute(const String& path);
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
 
-BTF_API bool isEqualPath(const String& path1, const String& path2);
+    return h;
+}
 
-// @brief Check if filesystem entity (file, directory, symlink, hardlink) of two paths is same one.
-BTF_API bool isSameFileSystemEntity(const String& path1, const String& path2);
+// @brief The 64-bit hash of XXH3 (with the default secret and seed 0), it can be computed at once or by streaming.
+// The long input is accumulated by the scalar, SSE2 or AVX2 kernel selected at runtime,
+// and all the kernels give the same result.
+class _Xxh3
+{
+public:
+    enum class Kernel
+    {
+        SCALAR,
+        SSE2,
+        AVX2
+    };
 
-// @return The size of the file or directory.
-BTF_API size_t sizes(const String& path);
+    explicit _Xxh3(Kernel kernel = bestKernel()) : kernel_(kernel) { reset(); }
 
-// @brief Create a directory.
-// @return If the directory is existed return false.
-// @note The parent directory must exists.
-BTF_API bool createDirectory(const String& path);
+    // @return The fastest kernel supported by the CPU, it is detected once.
+    static Kernel bestKernel()
+    {
+        static const Kernel kernel = detectKernel_();
+        return kernel;
+    }
 
-// @brief Create a directory tree.
-// @return If the directory is existed return false.
-// @note The parent directory can be not exists (create it automatically).
-BTF_API bool createDirectorys(const String& path);
+    static uint64_t hash(const void* data, size_t size, Kernel kernel = bestKernel())
+    {
+        const unsigned char* input = static_cast<const unsigned char*>(data);
 
-// @return The number of files and directories deleted.
-BTF_API size_t deletes(const String& path);
+        if (size <= MIDSIZE_MAX_)
+            return hashShort_(input, size);
 
-BTF_API void copy(const String& src, const String& dst, bool isOverwrite = false);
+        // All the stripes except the last one are accumulated, the last stripe is accumulated by #finish_.
+        _Xxh3 state(kernel);
+        state.consume_(input, (size - 1) / STRIPE_SIZE_);
 
-BTF_API void copySymlink(const String& src, const String& dst, bool isOverwrite = false);
+        return state.finish_(input + size - STRIPE_SIZE_, size);
+    }
 
-BTF_API void move(const String& src, const String& dst, bool isOverwrite = false);
+    void reset()
+    {
+        static const uint64_t INIT_ACC[ACC_COUNT_] = {P32_3, P64_1, P64_2, P64_3, P64_4, P32_2, P64_5, P32_1};
 
-BTF_API void reFilename(const String& path, const String& newFilename, bool isOverwrite = false);
+        std::memcpy(acc_, INIT_ACC, sizeof(acc_));
+        stripesInBlock_ = 0;
+        bufferedSize_ = 0;
+        totalSize_ = 0;
+    }
 
-BTF_API void reFilenameEx(const String& path, const String& newFilenameEx, bool isOverwrite = false);
+    void update(const void* data, size_t size)
+    {
+        const unsigned char* input = static_cast<const unsigned char*>(data);
+        totalSize_ += size;
 
-BTF_API void reExtension(const String& path, const String& newExtension, bool isOverwrite = false);
+        if (bufferedSize_ + size <= BUFFER_SIZE_) {
+            if (size > 0)
+                std::memcpy(buffer_ + bufferedSize_, input, size);
+            bufferedSize_ += size;
+            return;
+        }
 
-BTF_API void createSymlink(const String& src, const String& dst, bool isOverwrite = false);
+        // The data is accumulated only if more data follows it, so the last stripe is left for #digest.
+        if (bufferedSize_ > 0) {
+            size_t fill = BUFFER_SIZE_ - bufferedSize_;
+            std::memcpy(buffer_ + bufferedSize_, input, fill);
+            input += fill;
+            size -= fill;
 
-BTF_API String symlinkTarget(const String& path);
+            consume_(buffer_, BUFFER_SIZE_ / STRIPE_SIZE_);
+            bufferedSize_ = 0;
+        }
 
-BTF_API void createHardlink(const String& src, const String& dst, bool isOverwrite = false);
+        if (size > BUFFER_SIZE_) {
+            size_t stripes = (size - 1) / STRIPE_SIZE_;
+            consume_(input, stripes);
 
-BTF_API size_t hardlinkCount(const String& path);
+            // Keep the last stripe accumulated, the digest may need its tail.
+            std::memcpy(buffer_ + BUFFER_SIZE_ - STRIPE_SIZE_, input + (stripes - 1) * STRIPE_SIZE_, STRIPE_SIZE_);
+            input += stripes * STRIPE_SIZE_;
+            size -= stripes * STRIPE_SIZE_;
+        }
 
-BTF_API String tempDirectory();
+        std::memcpy(buffer_, input, size);
+        bufferedSize_ = size;
+    }
 
-// @return The pair of files and drietorys.
-BTF_API std::pair<Strings, Strings>
-getAlls(const String& path, bool isRecursive = true, bool (*filter)(const String&) = nullptr);
+    // @return The hash of all the data updated, the state is not changed.
+    uint64_t digest() const
+    {
+        if (totalSize_ <= MIDSIZE_MAX_)
+            return hashShort_(buffer_, static_cast<size_t>(totalSize_));
 
-BTF_API Strings getAllFiles(const String& path, bool isRecursive = true, bool (*filter)(const String&) = nullptr);
+        _Xxh3 state(*this);
 
-BTF_API Strings getAllDirectorys(const String& path, bool isRecursive = true, bool (*filter)(const String&) = nullptr);
+        if (bufferedSize_ >= STRIPE_SIZE_) {
+            state.consume_(buffer_, (bufferedSize_ - 1) / STRIPE_SIZE_);
+            return state.finish_(buffer_ + bufferedSize_ - STRIPE_SIZE_, totalSize_);
+        }
 
-#endif // !BTF_IMPL
+        // The last stripe is the tail of the data accumulated and the data buffered.
+        unsigned char lastStripe[STRIPE_SIZE_];
+        size_t catchup = STRIPE_SIZE_ - bufferedSize_;
 
-} // namespace btf
+        std::memcpy(lastStripe, buffer_ + BUFFER_SIZE_ - catchup, catchup);
+        std::memcpy(lastStripe + catchup, buffer_, bufferedSize_);
 
-// Implementation of utility functions with filesystem.
-namespace btf
-{
+        return state.finish_(lastStripe, totalSize_);
+    }
 
-#ifndef BTF_FWD
+private:
+    using AccumulateFn = void (*)(uint64_t*, const unsigned char*, const unsigned char*, size_t);
+    using ScrambleFn = void (*)(uint64_t*, const unsigned char*);
+
+    static constexpr uint64_t P32_1 = 0x9E3779B1U;
+    static constexpr uint64_t P32_2 = 0x85EBCA77U;
+    static constexpr uint64_t P32_3 = 0xC2B2AE3DU;
+    static constexpr uint64_t P64_1 = 0x9E3779B185EBCA87ULL;
+    static constexpr uint64_t P64_2 = 0xC2B2AE3D27D4EB4FULL;
+    static constexpr uint64_t P64_3 = 0x165667B19E3779F9ULL;
+    static constexpr uint64_t P64_4 = 0x85EBCA77C2B2AE63ULL;
+    static constexpr uint64_t P64_5 = 0x27D4EB2F165667C5ULL;
+    static constexpr uint64_t PMX_1 = 0x165667919E3779F9ULL;
+    static constexpr uint64_t PMX_2 = 0x9FB21C651E98DF25ULL;
+
+    static constexpr size_t ACC_COUNT_ = 8;
+    static constexpr size_t STRIPE_SIZE_ = 64;
+    static constexpr size_t SECRET_SIZE_ = 192;
+    static constexpr size_t SECRET_RATE_ = 8;       // The secret bytes consumed by each stripe.
+    static constexpr size_t BLOCK_STRIPES_ = (SECRET_SIZE_ - STRIPE_SIZE_) / SECRET_RATE_;
+    static constexpr size_t MIDSIZE_MAX_ = 240;
+    static constexpr size_t BUFFER_SIZE_ = 256;
+
+    static const unsigned char* secret_()
+    {
+        static const unsigned char SECRET[SECRET_SIZE_] = {
+            0xb8, 0xfe, 0x6c, 0x39, 0x23, 0xa4, 0x4b, 0xbe, 0x7c, 0x01, 0x81, 0x2c, 0xf7, 0x21, 0xad, 0x1c,
+            0xde, 0xd4, 0x6d, 0xe9, 0x83, 0x90, 0x97, 0xdb, 0x72, 0x40, 0xa4, 0xa4, 0xb7, 0xb3, 0x67, 0x1f,
+            0xcb, 0x79, 0xe6, 0x4e, 0xcc, 0xc0, 0xe5, 0x78, 0x82, 0x5a, 0xd0, 0x7d, 0xcc, 0xff, 0x72, 0x21,
+            0xb8, 0x08, 0x46, 0x74, 0xf7, 0x43, 0x24, 0x8e, 0xe0, 0x35, 0x90, 0xe6, 0x81, 0x3a, 0x26, 0x4c,
+            0x3c, 0x28, 0x52, 0xbb, 0x91, 0xc3, 0x00, 0xcb, 0x88, 0xd0, 0x65, 0x8b, 0x1b, 0x53, 0x2e, 0xa3,
+            0x71, 0x64, 0x48, 0x97, 0xa2, 0x0d, 0xf9, 0x4e, 0x38, 0x19, 0xef, 0x46, 0xa9, 0xde, 0xac, 0xd8,
+            0xa8, 0xfa, 0x76, 0x3f, 0xe3, 0x9c, 0x34, 0x3f, 0xf9, 0xdc, 0xbb, 0xc7, 0xc7, 0x0b, 0x4f, 0x1d,
+            0x8a, 0x51, 0xe0, 0x4b, 0xcd, 0xb4, 0x59, 0x31, 0xc8, 0x9f, 0x7e, 0xc9, 0xd9, 0x78, 0x73, 0x64,
+            0xea, 0xc5, 0xac, 0x83, 0x34, 0xd3, 0xeb, 0xc3, 0xc5, 0x81, 0xa0, 0xff, 0xfa, 0x13, 0x63, 0xeb,
+            0x17, 0x0d, 0xdd, 0x51, 0xb7, 0xf0, 0xda, 0x49, 0xd3, 0x16, 0x55, 0x26, 0x29, 0xd4, 0x68, 0x9e,
+            0x2b, 0x16, 0xbe, 0x58, 0x7d, 0x47, 0xa1, 0xfc, 0x8f, 0xf8, 0xb8, 0xd1, 0x7a, 0xd0, 0x31, 0xce,
+            0x45, 0xcb, 0x3a, 0x8f, 0x95, 0x16, 0x04, 0x28, 0xaf, 0xd7, 0xfb, 0xca, 0xbb, 0x4b, 0x40, 0x7e,
+        };
+
+        return SECRET;
+    }
 
-using _pth = fs::path;
+    static uint64_t read64_(const unsigned char* p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap64(v);
+#endif // __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return v;
+    }
 
-BTF_API String normalize(const String& path)
-{
-    return _pth(path).lexically_normal().generic_string();
-}
+    static uint32_t read32_(const unsigned char* p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, sizeof(v));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        v = __builtin_bswap32(v);
+#endif // __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        return v;
+    }
 
-BTF_API String currentPath()
-{
-    return fs::current_path().string();
-}
+    static uint64_t swap64_(uint64_t x)
+    {
+        return ((x << 56) & 0xff00000000000000ULL) | ((x << 40) & 0x00ff000000000000ULL) |
+               ((x << 24) & 0x0000ff0000000000ULL) | ((x << 8) & 0x000000ff00000000ULL) |
+               ((x >> 8) & 0x00000000ff000000ULL) | ((x >> 24) & 0x0000000000ff0000ULL) |
+               ((x >> 40) & 0x000000000000ff00ULL) | ((x >> 56) & 0x00000000000000ffULL);
+    }
 
-BTF_API String parentPath(const String& path)
-{
-    return _pth(path).parent_path().string();
-}
+    static uint64_t rotl64_(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
 
-BTF_API String parentName(const String& path)
-{
-    return _pth(path).parent_path().filename().string();
-}
+    // @return The xor of the low and the high 64 bits of the 128-bit product.
+    static uint64_t mulFold64_(uint64_t a, uint64_t b)
+    {
+#ifdef __SIZEOF_INT128__
+        __uint128_t product = static_cast<__uint128_t>(a) * b;
+        return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+        uint64_t lolo = (a & 0xFFFFFFFF) * (b & 0xFFFFFFFF);
+        uint64_t hilo = (a >> 32) * (b & 0xFFFFFFFF);
+        uint64_t lohi = (a & 0xFFFFFFFF) * (b >> 32);
+        uint64_t hihi = (a >> 32) * (b >> 32);
+        uint64_t cross = (lolo >> 32) + (hilo & 0xFFFFFFFF) + lohi;
+        uint64_t high = (hilo >> 32) + (cross >> 32) + hihi;
+        uint64_t low = (cross << 32) | (lolo & 0xFFFFFFFF);
+        return low ^ high;
+#endif // __SIZEOF_INT128__
+    }
 
-BTF_API String filenameEx(const String& path)
-{
-    return _pth(path).filename().string();
-}
+    static uint64_t xxh64Avalanche_(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= P64_2;
+        h ^= h >> 29;
+        h *= P64_3;
+        return h ^ (h >> 32);
+    }
 
-BTF_API String filename(const String& path)
-{
-    return _pth(path).filename().replace_extension().string();
-}
+    static uint64_t avalanche_(uint64_t h)
+    {
+        h ^= h >> 37;
+        h *= PMX_1;
+        return h ^ (h >> 32);
+    }
 
-BTF_API String extension(const String& path)
-{
-    return _pth(path).extension().string();
-}
+    static uint64_t mix16_(const unsigned char* input, const unsigned char* secret)
+    {
+        return mulFold64_(read64_(input) ^ read64_(secret), read64_(input + 8) ^ read64_(secret + 8));
+    }
 
-BTF_API bool isExists(const String& path)
-{
-    return fs::exists(path);
-}
+    // @brief The hash of the input not longer than #MIDSIZE_MAX_.
+    static uint64_t hashShort_(const unsigned char* input, size_t size)
+    {
+        const unsigned char* secret = secret_();
 
-BTF_API bool isFile(const String& path)
-{
-    return fs::exists(path) && fs::is_regular_file(path);
-}
+        if (size == 0)
+            return xxh64Avalanche_(read64_(secret + 56) ^ read64_(secret + 64));
 
-BTF_API bool isDirectory(const String& path)
-{
-    return fs::exists(path) && fs::is_directory(path);
-}
+        if (size <= 3) {
+            uint32_t combined = (static_cast<uint32_t>(input[0]) << 16) |
+                                (static_cast<uint32_t>(input[size >> 1]) << 24) |
+                                static_cast<uint32_t>(input[size - 1]) | (static_cast<uint32_t>(size) << 8);
+            uint64_t bitflip = read32_(secret) ^ read32_(secret + 4);
+            return xxh64Avalanche_(combined ^ bitflip);
+        }
 
-BTF_API bool isSymlink(const String& path)
-{
-    return fs::is_symlink(path);
-}
+        if (size <= 8) {
+            uint64_t bitflip = read64_(secret + 8) ^ read64_(secret + 16);
+            uint64_t value = read32_(input + size - 4) + (static_cast<uint64_t>(read32_(input)) << 32);
+            uint64_t h = value ^ bitflip;
+
+            // The rrmxmx mixer.
+            h ^= rotl64_(h, 49) ^ rotl64_(h, 24);
+            h *= PMX_2;
+            h ^= (h >> 35) + size;
+            h *= PMX_2;
+            return h ^ (h >> 28);
+        }
 
-BTF_API bool isEmpty(const String& path)
-{
-    return fs::is_empty(path);
-}
+        if (size <= 16) {
+            uint64_t low = read64_(input) ^ (read64_(secret + 24) ^ read64_(secret + 32));
+            uint64_t high = read64_(input + size - 8) ^ (read64_(secret + 40) ^ read64_(secret + 48));
+            return avalanche_(size + swap64_(low) + high + mulFold64_(low, high));
+        }
 
-BTF_API bool isSubPath(const String& path, const String& base)
-{
-    String _path = normalize(absolute(path));
-    String _base = normalize(absolute(base));
+        uint64_t acc = size * P64_1;
+
+        if (size <= 128) {
+            if (size > 32) {
+                if (size > 64) {
+                    if (size > 96) {
+                        acc += mix16_(input + 48, secret + 96);
+                        acc += mix16_(input + size - 64, secret + 112);
+                    }
+                    acc += mix16_(input + 32, secret + 64);
+                    acc += mix16_(input + size - 48, secret + 80);
+                }
+                acc += mix16_(input + 16, secret + 32);
+                acc += mix16_(input + size - 32, secret + 48);
+            }
+            acc += mix16_(input, secret);
+            acc += mix16_(input + size - 16, secret + 16);
 
-    return _path.substr(0, _base.size()) == _base;
-}
+            return avalanche_(acc);
+        }
 
-BTF_API bool isRelative(const String& path)
+        for (size_t i = 0; i < 8; ++i)
+            acc += mix16_(input + 16 * i, secret + 16 * i);
+
+        acc = avalanche_(acc);
+
+        uint64_t accEnd = mix16_(input + size - 16, secret + 136 - 17);
+        for (size_t i = 8; i < size / 16; ++i)
+            accEnd += mix16_(input + 16 * i, secret + 16 * (i - 8) + 3);
+
+        return avalanche_(acc + accEnd);
+    }
+
+    static void accumulateScalar_(uint64_t* acc, const unsigned char* input, const unsigned char* secret,
+                                  size_t stripes)
+    {
+        for (size_t n = 0; n < stripes; ++n) {
+            const unsigned char* in = input + n * STRIPE_SIZE_;
+            const unsigned char* key = secret + n * SECRET_RATE_;
+
+            for (size_t i = 0; i < ACC_COUNT_; ++i) {
+                uint64_t value = read64_(in + 8 * i);
+                uint64_t valueKey = value ^ read64_(key + 8 * i);
+
+                acc[i ^ 1] += value;
+                acc[i] += (valueKey & 0xFFFFFFFF) * (valueKey >> 32);
+            }
+        }
+    }
+
+    static void scrambleScalar_(uint64_t* acc, const unsigned char* secret)
+    {
+        for (size_t i = 0; i < ACC_COUNT_; ++i) {
+            uint64_t value = acc[i];
+            value ^= value >> 47;
+            value ^= read64_(secret + 8 * i);
+            acc[i] = value * P32_1;
+        }
+    }
+
+#ifdef _BETTERFILE_X86_64
+    static void accumulateSse2_(uint64_t* acc, const unsigned char* input, const unsigned char* secret,
+                                size_t stripes)
+    {
+        __m128i lanes[4];
+        for (size_t i = 0; i < 4; ++i)
+            lanes[i] = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + i);
+
+        for (size_t n = 0; n < stripes; ++n) {
+            const __m128i* in = reinterpret_cast<const __m128i*>(input + n * STRIPE_SIZE_);
+            const __m128i* key = reinterpret_cast<const __m128i*>(secret + n * SECRET_RATE_);
+
+            for (size_t i = 0; i < 4; ++i) {
+                __m128i value = _mm_loadu_si128(in + i);
+                __m128i valueKey = _mm_xor_si128(value, _mm_loadu_si128(key + i));
+                __m128i product = _mm_mul_epu32(valueKey, _mm_shuffle_epi32(valueKey, _MM_SHUFFLE(0, 3, 0, 1)));
+                __m128i swapped = _mm_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+
+                lanes[i] = _mm_add_epi64(product, _mm_add_epi64(lanes[i], swapped));
+            }
+        }
+
+        for (size_t i = 0; i < 4; ++i)
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + i, lanes[i]);
+    }
+
+    static void scrambleSse2_(uint64_t* acc, const unsigned char* secret)
+    {
+        const __m128i prime = _mm_set1_epi32(static_cast<int>(P32_1));
+
+        for (size_t i = 0; i < 4; ++i) {
+            __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i*>(acc) + i);
+            value = _mm_xor_si128(value, _mm_srli_epi64(value, 47));
+            value = _mm_xor_si128(value, _mm_loadu_si128(reinterpret_cast<const __m128i*>(secret) + i));
+
+            __m128i low = _mm_mul_epu32(value, prime);
+            __m128i high = _mm_mul_epu32(_mm_shuffle_epi32(value, _MM_SHUFFLE(0, 3, 0, 1)), prime);
+
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(acc) + i, _mm_add_epi64(low, _mm_slli_epi64(high, 32)));
+        }
+    }
+#endif // _BETTERFILE_X86_64
+
+#ifdef _BETTERFILE_AVX2
+    __attribute__((target("avx2")))
+    static void accumulateAvx2_(uint64_t* acc, const unsigned char* input, const unsigned char* secret,
+                                size_t stripes)
+    {
+        __m256i lanes[2];
+        for (size_t i = 0; i < 2; ++i)
+            lanes[i] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc) + i);
+
+        for (size_t n = 0; n < stripes; ++n) {
+            const __m256i* in = reinterpret_cast<const __m256i*>(input + n * STRIPE_SIZE_);
+            const __m256i* key = reinterpret_cast<const __m256i*>(secret + n * SECRET_RATE_);
+
+            for (size_t i = 0; i < 2; ++i) {
+                __m256i value = _mm256_loadu_si256(in + i);
+                __m256i valueKey = _mm256_xor_si256(value, _mm256_loadu_si256(key + i));
+                __m256i product = _mm256_mul_epu32(valueKey, _mm256_srli_epi64(valueKey, 32));
+                __m256i swapped = _mm256_shuffle_epi32(value, _MM_SHUFFLE(1, 0, 3, 2));
+
+                lanes[i] = _mm256_add_epi64(product, _mm256_add_epi64(lanes[i], swapped));
+            }
+        }
+
+        for (size_t i = 0; i < 2; ++i)
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc) + i, lanes[i]);
+    }
+
+    __attribute__((target("avx2")))
+    static void scrambleAvx2_(uint64_t* acc, const unsigned char* secret)
+    {
+        const __m256i prime = _mm256_set1_epi32(static_cast<int>(P32_1));
+
+        for (size_t i = 0; i < 2; ++i) {
+            __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(acc) + i);
+            value = _mm256_xor_si256(value, _mm256_srli_epi64(value, 47));
+            value = _mm256_xor_si256(value, _mm256_loadu_si256(reinterpret_cast<const __m256i*>(secret) + i));
+
+            __m256i low = _mm256_mul_epu32(value, prime);
+            __m256i high = _mm256_mul_epu32(_mm256_srli_epi64(value, 32), prime);
+
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(acc) + i,
+                                _mm256_add_epi64(low, _mm256_slli_epi64(high, 32)));
+        }
+    }
+#endif // _BETTERFILE_AVX2
+
+    static Kernel detectKernel_()
+    {
+#ifdef _BETTERFILE_AVX2
+        if (__builtin_cpu_supports("avx2"))
+            return Kernel::AVX2;
+#endif // _BETTERFILE_AVX2
+
+#ifdef _BETTERFILE_X86_64
+        return Kernel::SSE2;
+#else
+        return Kernel::SCALAR;
+#endif // _BETTERFILE_X86_64
+    }
+
+    void accumulate_(const unsigned char* input, const unsigned char* secret, size_t stripes)
+    {
+        switch (kernel_) {
+#ifdef _BETTERFILE_AVX2
+            case Kernel::AVX2:
+                accumulateAvx2_(acc_, input, secret, stripes);
+                return;
+#endif // _BETTERFILE_AVX2
+#ifdef _BETTERFILE_X86_64
+            case Kernel::SSE2:
+                accumulateSse2_(acc_, input, secret, stripes);
+                return;
+#endif // _BETTERFILE_X86_64
+            default:
+                accumulateScalar_(acc_, input, secret, stripes);
+                return;
+        }
+    }
+
+    void scramble_(const unsigned char* secret)
+    {
+        switch (kernel_) {
+#ifdef _BETTERFILE_AVX2
+            case Kernel::AVX2:
+                scrambleAvx2_(acc_, secret);
+                return;
+#endif // _BETTERFILE_AVX2
+#ifdef _BETTERFILE_X86_64
+            case Kernel::SSE2:
+                scrambleSse2_(acc_, secret);
+                return;
+#endif // _BETTERFILE_X86_64
+            default:
+                scrambleScalar_(acc_, secret);
+                return;
+        }
+    }
+
+    // @brief Accumulate the stripes which are followed by more data, the accumulators are scrambled
+    // after each block.
+    void consume_(const unsigned char* input, size_t stripes)
+    {
+        const unsigned char* secret = secret_();
+
+        while (stripes > 0) {
+            size_t count = std::min(stripes, BLOCK_STRIPES_ - stripesInBlock_);
+
+            accumulate_(input, secret + stripesInBlock_ * SECRET_RATE_, count);
+            input += count * STRIPE_SIZE_;
+            stripes -= count;
+            stripesInBlock_ += count;
+
+            if (stripesInBlock_ == BLOCK_STRIPES_) {
+                scramble_(secret + SECRET_SIZE_ - STRIPE_SIZE_);
+                stripesInBlock_ = 0;
+            }
+        }
+    }
+
+    // @brief Accumulate the last stripe (the last 64 bytes) and merge the accumulators.
+    uint64_t finish_(const unsigned char* lastStripe, uint64_t totalSize)
+    {
+        const unsigned char* secret = secret_();
+
+        accumulate_(lastStripe, secret + SECRET_SIZE_ - STRIPE_SIZE_ - 7, 1);
+
+        uint64_t result = totalSize * P64_1;
+        for (size_t i = 0; i < 4; ++i)
+            result += mulFold64_(acc_[2 * i] ^ read64_(secret + 11 + 16 * i),
+                                 acc_[2 * i + 1] ^ read64_(secret + 11 + 16 * i + 8));
+
+        return avalanche_(result);
+    }
+
+    Kernel kernel_;
+    uint64_t acc_[ACC_COUNT_];
+    size_t stripesInBlock_;
+    unsigned char buffer_[BUFFER_SIZE_];
+    size_t bufferedSize_;
+    uint64_t totalSize_;
+};
+
+// @brief The 64-bit non-cryptographic hash of the data (XXH3, SIMD accelerated if supported).
+inline uint64_t hash64(const void* data, size_t size)
 {
-    return _pth(path).is_relative();
+    return _Xxh3::hash(data, size);
 }
 
-BTF_API bool isAbsolute(const String& path)
+// @brief The child of a directory in the Merkle hash.
+struct _MerkleEntry
 {
-    return _pth(path).is_absolute();
-}
+    const String* name;
+    bool isDir;
+    uint64_t hash;
+};
 
-BTF_API String relative(const String& path, const String& base)
+// @brief The Merkle hash of a directory by the names, types and hashes of its children.
+// The children are sorted by name, so the hash is independent of the order of children.
+inline uint64_t _merkleHash(Vec<_MerkleEntry>& entries)
 {
-    return fs::relative(path, base).string();
+    std::sort(entries.begin(), entries.end(), [](const _MerkleEntry& a, const _MerkleEntry& b) {
+        int result = a.name->compare(*b.name);
+        return result < 0 || (result == 0 && a.isDir < b.isDir);
+    });
+
+    // Each child is serialized as the type, the name with a terminating zero and the hash in little endian.
+    String record;
+    for (const auto& var : entries) {
+        record.push_back(var.isDir ? 'D' : 'F');
+        record.append(var.name->c_str(), var.name->size() + 1);
+
+        for (size_t i = 0; i < 8; ++i)
+            record.push_back(static_cast<char>(var.hash >> (8 * i)));
+    }
+
+    return hash64(record.data(), record.size());
 }
 
-BTF_API String absolute(const String& path)
+} // namespace btf
+
+// Instrumentation, it is compiled only if BTF_INSTRUMENT is defined, else the hooks in the library are empty macros.
+#ifdef BTF_INSTRUMENT
+namespace btf
 {
-    return fs::absolute(path).string();
-}
 
-BTF_API bool isEqualPath(const String& path1, const String& path2)
+// The counter of the operations, the counts are inclusive (the counts of the nested operations are included).
+enum class InstrumentCounter
 {
-    String _path1 = normalize(absolute(path1));
-    String _path2 = normalize(absolute(path2));
+    SYSCALLS,           // The system calls (the std::filesystem calls are counted as one each).
+    BYTES_READ,
+    BYTES_WRITTEN,
+    ENTRIES_VISITED     // The directory entries read.
+};
 
-    return _path1 == _path2;
-}
+constexpr uint INSTRUMENT_COUNTER_COUNT = 4;
 
-BTF_API bool isSameFileSystemEntity(const String& path1, const String& path2)
-{
-    return fs::equivalent(path1, path2);
-}
+// The bucket i of the latency histogram counts the latencies in [2^(i-1), 2^i) nanoseconds.
+constexpr uint INSTRUMENT_HISTOGRAM_BUCKETS = 64;
 
-BTF_API size_t sizes(const String& path)
+// The max number of the instrumented operations, the operations registered after it share the last one.
+constexpr uint _INSTRUMENT_MAX_OPS = 128;
+
+// The statistics of an operation (a public function) of all threads.
+struct InstrumentStats
 {
-    if (isFile(path)) {
-        return fs::file_size(path);
-    } else if (isDirectory(path)) {
-        size_t rslt = 0;
+    String name;
+    uint64_t calls = 0;
+    uint64_t nanoseconds = 0;
+    uint64_t counters[INSTRUMENT_COUNTER_COUNT] = {};        // Indexed by #InstrumentCounter.
+    uint64_t histogram[INSTRUMENT_HISTOGRAM_BUCKETS] = {};
+
+    // @return The upper bound of the latency (nanoseconds) of the percentile p (0 to 1) by the histogram.
+    uint64_t percentile(double p) const
+    {
+        uint64_t rank = static_cast<uint64_t>(p * calls);
+        uint64_t count = 0;
 
-        for (const auto& var : fs::recursive_directory_iterator(path))
-            rslt += (var.is_regular_file() ? var.file_size() : 0);
+        for (uint i = 0; i < INSTRUMENT_HISTOGRAM_BUCKETS; ++i) {
+            count += histogram[i];
+            if (count > rank || (count == calls && count > 0))
+                return i == 0 ? 0 : (i >= 63 ? UINT64_MAX : (uint64_t(1) << i));
+        }
 
-        return rslt;
-    } else {
-        throw Exception(_fmt("The specified path not exists. \"{}\"", path));
+        return 0;
     }
-}
+};
 
-BTF_API bool createDirectory(const String& path)
-{
-    return fs::create_directory(path);
-}
+// The hook called when an operation begins.
+using InstrumentBeginHook = void (*)(const char* op);
 
-BTF_API bool createDirectorys(const String& path)
-{
-    return fs::create_directories(path);
-}
+// The hook called when an operation ends, the counters are the counts of this call (indexed by #InstrumentCounter).
+using InstrumentEndHook = void (*)(const char* op, uint64_t nanoseconds, const uint64_t* counters);
 
-// @return If the path not exists, return 0.
-// @note Even if the path not exists not throw exception.
-BTF_API size_t deletes(const String& path)
+class _Instrument
 {
-    return fs::remove_all(path);
-}
+public:
+    // The statistics of an operation of a thread, it is only written by the owner thread,
+    // so the atomic is just loaded and stored (no lock and no read-modify-write).
+    struct Op
+    {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> nanoseconds{0};
+        std::atomic<uint64_t> counters[INSTRUMENT_COUNTER_COUNT] = {};
+        std::atomic<uint64_t> histogram[INSTRUMENT_HISTOGRAM_BUCKETS] = {};
+    };
 
-BTF_API void copy(const String& src, const String& dst, bool isOverwrite)
-{
-    // If the source path equals the destination path, do nothing.
-    if (isEqualPath(src, dst))
-        return;
+    struct Thread
+    {
+        Thread()
+        {
+            std::lock_guard<std::mutex> lock(registry_().mtx);
+            registry_().threads.push_back(this);
+        }
 
-    if (isFile(src)) {
-        // If the destination path exists same name file or directory and specified not overwrite, do nothing.
-        if (!isOverwrite && isExists(dst))
-            return;
+        Thread(const Thread&) = delete;
 
-        // If the destination path has a same name directory (not file), throw exception.
-        if (isDirectory(dst))
-            throw Exception(_fmt("The destination path contains same name directory. \"{}\" -> \"{}\"", src, dst));
+        Thread& operator=(const Thread&) = delete;
 
-        // Create the parent directory of the destination path first if not exists.
-        if (!isDirectory(parentPath(dst)))
-            createDirectorys(parentPath(dst));
+        // The statistics of the exited thread are kept by the registry.
+        ~Thread()
+        {
+            Registry& registry = registry_();
+            std::lock_guard<std::mutex> lock(registry.mtx);
 
-        // If the destination path is a file, delete it first.
-        // #deletes can automatically handle the case of not exists deleted file.
-        deletes(dst);
-        fs::copy_file(src, dst);
-    } else if (isDirectory(src)) {
-        // If the destination path has a same name file (not directory), throw exception.
-        if (isFile(dst))
-            throw Exception(_fmt("The destination path contains same name file. \"{}\" -> \"{}\"", src, dst));
+            for (uint i = 0; i < _INSTRUMENT_MAX_OPS; ++i)
+                merge_(registry.retired.ops[i], ops[i]);
 
-        // If attempt to copy a directory to a subdirectory, throw exception.
-        if (isSubPath(dst, src))
-            throw Exception(_fmt("Can't copy directory to a subdirectory. \"{}\" -> \"{}\"", src, dst));
+            registry.threads.erase(std::find(registry.threads.begin(), registry.threads.end(), this));
+        }
 
-        // For each file in the source directory, copy it to the destination directory.
-        for (const auto& var : fs::recursive_directory_iterator(src)) {
-            if (var.is_regular_file())
-                copy(var.path().string(), pathcat(dst, var.path().string().substr(src.size())), isOverwrite);
-            else if (var.is_directory())
-                createDirectorys(pathcat(dst, var.path().string().substr(src.size())));
+        uint64_t counters[INSTRUMENT_COUNTER_COUNT] = {};   // The running counts of the thread.
+        uint depths[_INSTRUMENT_MAX_OPS] = {};              // The depth of the recursive calls of each operation.
+        Op ops[_INSTRUMENT_MAX_OPS];
+    };
+
+    static Thread& local()
+    {
+        static thread_local std::unique_ptr<Thread> thread(new Thread());
+        return *thread;
+    }
+
+    // @brief Same as #local, but if failed to create the statistics of the thread return nullptr,
+    // so the scope of a noexcept function never throws.
+    static Thread* tryLocal() noexcept
+    {
+        try {
+            return &local();
+        } catch (...) {
+            return nullptr;
         }
-    } else {
-        throw Exception(_fmt("The specified source path not exists. \"{}\"", src));
     }
-}
 
-BTF_API void copySymlink(const String& src, const String& dst, bool isOverwrite)
-{
-    if (!isOverwrite && isExists(dst))
-        return;
+    // @brief Add n to the counter of the current thread, if failed to create the statistics of the thread
+    // the count is dropped (nothing is thrown).
+    static void count(size_t counter, uint64_t n) noexcept
+    {
+        Thread* thread = tryLocal();
+        if (thread)
+            thread->counters[counter] += n;
+    }
 
-    deletes(dst);
-    fs::copy_symlink(src, dst);
-}
+    // @return The id of the operation, the overloads of a function have the same name and share the id.
+    // If the operations are too many (or failed to lock), the last id is shared.
+    // @note The name must be a string literal.
+    static size_t registerOp(const char* name) noexcept
+    {
+        Registry& registry = registry_();
+        size_t id = _INSTRUMENT_MAX_OPS - 1;
 
-BTF_API void move(const String& src, const String& dst, bool isOverwrite)
-{
-    // If the source path equals the destination path, do nothing.
-    if (isEqualPath(src, dst))
-        return;
+        try {
+            std::lock_guard<std::mutex> lock(registry.mtx);
+
+            for (size_t i = 0; i < registry.nameCount; ++i) {
+                if (std::strcmp(registry.names[i], name) == 0)
+                    return i;
+            }
+
+            if (registry.nameCount < _INSTRUMENT_MAX_OPS)
+                registry.names[registry.nameCount++] = name;
+
+            id = registry.nameCount - 1;
+        } catch (...) {
+        }
+
+        return id;
+    }
+
+    static std::atomic<InstrumentBeginHook>& beginHook()
+    {
+        static std::atomic<InstrumentBeginHook> hook{nullptr};
+        return hook;
+    }
+
+    static std::atomic<InstrumentEndHook>& endHook()
+    {
+        static std::atomic<InstrumentEndHook> hook{nullptr};
+        return hook;
+    }
+
+    static void add(std::atomic<uint64_t>& value, uint64_t n)
+    {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    static Vec<InstrumentStats> snapshot()
+    {
+        Registry& registry = registry_();
+        std::lock_guard<std::mutex> lock(registry.mtx);
+
+        Vec<InstrumentStats> result(registry.nameCount);
+
+        for (size_t i = 0; i < result.size(); ++i) {
+            result[i].name = registry.names[i];
+            sum_(result[i], registry.retired.ops[i]);
+
+            for (const auto var : registry.threads)
+                sum_(result[i], var->ops[i]);
+        }
+
+        return result;
+    }
+
+    // @note The statistics being written by other threads at the same time may be not reset.
+    static void reset()
+    {
+        Registry& registry = registry_();
+        std::lock_guard<std::mutex> lock(registry.mtx);
+
+        for (uint i = 0; i < _INSTRUMENT_MAX_OPS; ++i) {
+            clear_(registry.retired.ops[i]);
+
+            for (const auto var : registry.threads)
+                clear_(var->ops[i]);
+        }
+    }
+
+private:
+    struct Registry
+    {
+        struct Retired
+        {
+            Op ops[_INSTRUMENT_MAX_OPS];
+        };
+
+        // The names are not allocated, so the registration never throws.
+        std::mutex mtx;
+        const char* names[_INSTRUMENT_MAX_OPS] = {};
+        size_t nameCount = 0;
+        Vec<Thread*> threads;
+        Retired retired;
+    };
+
+    static Registry& registry_()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    static void merge_(Op& to, const Op& from)
+    {
+        add(to.calls, from.calls.load(std::memory_order_relaxed));
+        add(to.nanoseconds, from.nanoseconds.load(std::memory_order_relaxed));
+
+        for (uint i = 0; i < INSTRUMENT_COUNTER_COUNT; ++i)
+            add(to.counters[i], from.counters[i].load(std::memory_order_relaxed));
+
+        for (uint i = 0; i < INSTRUMENT_HISTOGRAM_BUCKETS; ++i)
+            add(to.histogram[i], from.histogram[i].load(std::memory_order_relaxed));
+    }
+
+    static void sum_(InstrumentStats& to, const Op& from)
+    {
+        to.calls += from.calls.load(std::memory_order_relaxed);
+        to.nanoseconds += from.nanoseconds.load(std::memory_order_relaxed);
+
+        for (uint i = 0; i < INSTRUMENT_COUNTER_COUNT; ++i)
+            to.counters[i] += from.counters[i].load(std::memory_order_relaxed);
+
+        for (uint i = 0; i < INSTRUMENT_HISTOGRAM_BUCKETS; ++i)
+            to.histogram[i] += from.histogram[i].load(std::memory_order_relaxed);
+    }
+
+    static void clear_(Op& op)
+    {
+        op.calls.store(0, std::memory_order_relaxed);
+        op.nanoseconds.store(0, std::memory_order_relaxed);
+
+        for (auto& var : op.counters)
+            var.store(0, std::memory_order_relaxed);
+
+        for (auto& var : op.histogram)
+            var.store(0, std::memory_order_relaxed);
+    }
+};
+
+// @brief Measure an operation in the scope, the latency and the counts are added to the statistics of the thread.
+// The recursive calls of an operation are measured as a part of its outermost call.
+class _InstrumentScope
+{
+public:
+    // @note If failed to create the statistics of the thread, the call is not measured (nothing is thrown).
+    _InstrumentScope(size_t op, const char* name) : thread_(_Instrument::tryLocal()), op_(op), name_(name)
+    {
+        if (!thread_ || thread_->depths[op_]++ > 0)
+            return;
+
+        InstrumentBeginHook hook = _Instrument::beginHook().load(std::memory_order_acquire);
+        if (hook)
+            hook(name_);
+
+        std::copy(thread_->counters, thread_->counters + INSTRUMENT_COUNTER_COUNT, counters_);
+        start_ = std::chrono::steady_clock::now();
+    }
+
+    _InstrumentScope(const _InstrumentScope&) = delete;
+
+    _InstrumentScope& operator=(const _InstrumentScope&) = delete;
+
+    ~_InstrumentScope()
+    {
+        if (!thread_ || --thread_->depths[op_] > 0)
+            return;
+
+        uint64_t ns = static_cast<uint64_t>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start_).count());
+        _Instrument::Op& op = thread_->ops[op_];
+
+        for (uint i = 0; i < INSTRUMENT_COUNTER_COUNT; ++i) {
+            counters_[i] = thread_->counters[i] - counters_[i];
+            _Instrument::add(op.counters[i], counters_[i]);
+        }
+
+        uint bucket = 0;
+        while (bucket < INSTRUMENT_HISTOGRAM_BUCKETS - 1 && (ns >> bucket) != 0)
+            ++bucket;
+
+        _Instrument::add(op.calls, 1);
+        _Instrument::add(op.nanoseconds, ns);
+        _Instrument::add(op.histogram[bucket], 1);
+
+        InstrumentEndHook hook = _Instrument::endHook().load(std::memory_order_acquire);
+        if (hook)
+            hook(name_, ns, counters_);
+    }
+
+private:
+    _Instrument::Thread* thread_;
+    size_t op_;
+    const char* name_;
+    uint64_t counters_[INSTRUMENT_COUNTER_COUNT];
+    std::chrono::steady_clock::time_point start_;
+};
+
+// @brief Set the hooks called when each instrumented operation begins and ends, nullptr to remove.
+// The hooks are called by the thread which runs the operation, so they must be thread-safe.
+inline void setInstrumentHooks(InstrumentBeginHook onBegin, InstrumentEndHook onEnd)
+{
+    _Instrument::beginHook().store(onBegin, std::memory_order_release);
+    _Instrument::endHook().store(onEnd, std::memory_order_release);
+}
+
+// @return The statistics of all the operations called (include the threads exited).
+inline Vec<InstrumentStats> instrumentSnapshot()
+{
+    return _Instrument::snapshot();
+}
+
+inline void resetInstrument()
+{
+    _Instrument::reset();
+}
+
+} // namespace btf
+
+// Measure the operation in the current scope.
+#define _BETTERFILE_SCOPE(name)                                                 \
+    static const size_t _btfInstrumentOp = ::btf::_Instrument::registerOp(name); \
+    ::btf::_InstrumentScope _btfInstrumentScope(_btfInstrumentOp, name)
+
+// Add n to the counter (the name of #InstrumentCounter) of the current thread.
+#define _BETTERFILE_COUNT(counter, n) \
+    ::btf::_Instrument::count(static_cast<size_t>(::btf::InstrumentCounter::counter), static_cast<uint64_t>(n))
+#else
+#define _BETTERFILE_SCOPE(name)
+#define _BETTERFILE_COUNT(counter, n)
+#endif // BTF_INSTRUMENT
+
+// Platform utilities.
+namespace btf
+{
+
+#ifdef _BETTERFILE_LINUX
+
+// @brief The owner of a file descriptor, close it when destroyed.
+class _Fd
+{
+public:
+    explicit _Fd(int fd = -1) : fd_(fd) {}
+
+    _Fd(const _Fd&) = delete;
+
+    _Fd(_Fd&& other) noexcept : fd_(other.fd_) { other.fd_ = -1; }
+
+    ~_Fd() { reset(); }
+
+    _Fd& operator=(const _Fd&) = delete;
+
+    _Fd& operator=(_Fd&& other) noexcept
+    {
+        if (this != &other) {
+            reset(other.fd_);
+            other.fd_ = -1;
+        }
+
+        return *this;
+    }
+
+    int get() const { return fd_; }
+
+    bool valid() const { return fd_ >= 0; }
+
+    int release()
+    {
+        int fd = fd_;
+        fd_ = -1;
+        return fd;
+    }
+
+    void reset(int fd = -1)
+    {
+        if (fd_ >= 0)
+            ::close(fd_);
+        fd_ = fd;
+    }
+
+private:
+    int fd_;
+};
+
+// @brief Write all data to the file descriptor, retry on the partial write and interrupt.
+// @return If succeeded return true, else return false and the errno is set.
+inline bool _writeAll(int fd, const char* data, size_t size)
+{
+    while (size > 0) {
+        ssize_t n = ::write(fd, data, size);
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            return false;
+        }
+
+        _BETTERFILE_COUNT(BYTES_WRITTEN, n);
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+
+    return true;
+}
+
+// @brief Append all the rest data of the file descriptor to the string, read directly into the string storage.
+// The regular file is resized by its size once, other (pipe, socket...) grows geometrically.
+// @param bufferSize The max size of each read.
+// @return If succeeded return true, else return false and the errno is set.
+inline bool _readAll(int fd, String& out, size_t bufferSize)
+{
+    size_t used = out.size();
+    size_t hint = 0;
+
+    struct stat st;
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+    if (::fstat(fd, &st) == 0 && S_ISREG(st.st_mode)) {
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+        off_t pos = ::lseek(fd, 0, SEEK_CUR);
+        if (pos >= 0 && st.st_size > pos)
+            hint = static_cast<size_t>(st.st_size - pos);
+    }
+
+    // One more byte than the hint, so the end of file is detected without grow.
+    out.resize(used + (hint > 0 ? hint + 1 : bufferSize));
+
+    while (true) {
+        if (used == out.size())
+            out.resize(std::max(out.size() * 2, used + bufferSize));
+
+        ssize_t n = ::read(fd, &out[used], std::min(bufferSize, out.size() - used));
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0) {
+            out.resize(used);
+            return false;
+        }
+
+        if (n == 0)
+            break;
+
+        _BETTERFILE_COUNT(BYTES_READ, n);
+        used += static_cast<size_t>(n);
+    }
+
+    out.resize(used);
+
+    return true;
+}
+
+// @brief Append the data of the file to the string by O_DIRECT (bypass the page cache).
+// @return If the file can't be read by O_DIRECT (e.g. the tmpfs not supports) return false,
+// and the string is not changed.
+inline bool _readDirect(const String& path, String& out, size_t bufferSize)
+{
+    // The O_DIRECT requires the buffer, the size and the offset are aligned to the logical block size.
+    constexpr size_t align = 4096;
+
+    // The open and the fstat.
+    _BETTERFILE_COUNT(SYSCALLS, 2);
+
+    _Fd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT));
+
+    if (!fd.valid())
+        return false;
+
+    struct stat st;
+    if (::fstat(fd.get(), &st) != 0 || !S_ISREG(st.st_mode))
+        return false;
+
+    bufferSize = (std::max(bufferSize, align) + align - 1) / align * align;
+
+    void* buffer = nullptr;
+    if (::posix_memalign(&buffer, align, bufferSize) != 0)
+        return false;
+    std::unique_ptr<void, void (*)(void*)> bufferGuard(buffer, std::free);
+
+    size_t used = out.size();
+    out.reserve(used + static_cast<size_t>(st.st_size));
+
+    off_t offset = 0;
+    while (true) {
+        ssize_t n = ::pread(fd.get(), buffer, bufferSize, offset);
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0) {
+            out.resize(used);
+            return false;
+        }
+
+        if (n == 0)
+            break;
+
+        _BETTERFILE_COUNT(BYTES_READ, n);
+        out.append(static_cast<const char*>(buffer), static_cast<size_t>(n));
+        offset += n;
+
+        // A short read is not the end of file (e.g. interrupted), only the empty one is. But the next offset
+        // must be aligned, so only the unaligned tail of the file ends the read here, else read it by buffered I/O.
+        if (static_cast<size_t>(offset) % align != 0) {
+            if (offset >= st.st_size)
+                break;
+
+            out.resize(used);
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#endif // _BETTERFILE_LINUX
+
+// @brief A monotonic memory arena, the memory is allocated from large blocks
+// and is only released all at once when the arena is destroyed. It is thread-safe.
+// @note Only the data of files can be placed in an arena (see #File::fromDiskPath), so the data of a large tree
+// is allocated by a few blocks and released in O(blocks) instead of one by one. The nodes of a tree (the children
+// of #Dir) and the names are not placed in the arena, they are still allocated and released one by one.
+class Arena
+{
+public:
+    // @param blockSize The size of each block, the allocation larger than a quarter of it has its own block.
+    explicit Arena(size_t blockSize = 1024 * 1024) : blockSize_(std::max<size_t>(blockSize, _BUFFER_SIZE)) {}
+
+    Arena(const Arena&) = delete;
+
+    Arena& operator=(const Arena&) = delete;
+
+    // @param alignment Must be a power of 2 and not greater than alignof(std::max_align_t).
+    // @return The memory which is valid until the arena is destroyed.
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t))
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        bytes_ += size;
+
+        if (size > blockSize_ / 4) {
+            blocks_.emplace_back(new char[size]);
+            return blocks_.back().get();
+        }
+
+        size_t offset = (used_ + alignment - 1) & ~(alignment - 1);
+
+        if (current_ == nullptr || offset + size > blockSize_) {
+            blocks_.emplace_back(new char[blockSize_]);
+            current_ = blocks_.back().get();
+            offset = 0;
+        }
+
+        used_ = offset + size;
+
+        return current_ + offset;
+    }
+
+    // @return The total size allocated from the arena.
+    size_t bytes() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return bytes_;
+    }
+
+    // @return The number of blocks allocated by the arena.
+    size_t blockCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return blocks_.size();
+    }
+
+private:
+    const size_t blockSize_;
+    Vec<std::unique_ptr<char[]>> blocks_;
+    char* current_ = nullptr;
+    size_t used_ = 0;
+    size_t bytes_ = 0;
+    mutable std::mutex mutex_;
+};
+
+// @brief A read-only memory mapped file region, unmap it when destroyed.
+// It also can be a region of an arena which is released with the arena.
+class _MappedRegion
+{
+public:
+    _MappedRegion(const _MappedRegion&) = delete;
+
+    _MappedRegion& operator=(const _MappedRegion&) = delete;
+
+    ~_MappedRegion()
+    {
+#ifdef _BETTERFILE_LINUX
+        if (data_ && isMapped_)
+            ::munmap(const_cast<char*>(data_), size_);
+#endif // _BETTERFILE_LINUX
+    }
+
+    // @brief Make the region of the data which is allocated from the arena, the region itself is also
+    // allocated from the arena and shares the ownership of the arena (no other allocation).
+    static std::shared_ptr<const _MappedRegion> fromArena(const std::shared_ptr<Arena>& arena,
+                                                          const char* data, size_t size)
+    {
+        void* memory = arena->allocate(sizeof(_MappedRegion), alignof(_MappedRegion));
+        auto region = new (memory) _MappedRegion(data, size, false);
+
+        // The region is never destroyed, it is released with the arena.
+        return std::shared_ptr<const _MappedRegion>(arena, region);
+    }
+
+    // @brief Make the regions of the ranges (offset and size) of the region, they share the ownership
+    // of the region, and the region objects are allocated once for all.
+    static Vec<std::shared_ptr<const _MappedRegion>>
+    slice(const std::shared_ptr<const _MappedRegion>& region, const Vec<std::pair<size_t, size_t>>& ranges)
+    {
+        struct Slices
+        {
+            std::shared_ptr<const _MappedRegion> parent;
+            void* memory = nullptr;
+
+            // The slices don't own the mapping, so they are never destroyed.
+            ~Slices() { ::operator delete(memory); }
+        };
+
+        auto slices = std::make_shared<Slices>();
+        slices->parent = region;
+        slices->memory = ::operator new(sizeof(_MappedRegion) * std::max<size_t>(ranges.size(), 1));
+
+        Vec<std::shared_ptr<const _MappedRegion>> result;
+        result.reserve(ranges.size());
+
+        for (size_t i = 0; i < ranges.size(); ++i) {
+            auto slice = new (static_cast<_MappedRegion*>(slices->memory) + i)
+                _MappedRegion(region->data() + ranges[i].first, ranges[i].second, region->isMapped_, region->device_,
+                              region->inode_);
+
+            result.emplace_back(slices, slice);
+        }
+
+        return result;
+    }
+
+    // @brief Map the whole file read-only.
+    // @return The mapped region, if the platform not supports or failed to map return nullptr.
+    static std::shared_ptr<const _MappedRegion> map(const String& path, LoadMode mode)
+    {
+#ifdef _BETTERFILE_LINUX
+        _Fd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+
+        if (!fd.valid())
+            return nullptr;
+
+        struct stat st;
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+        if (::fstat(fd.get(), &st) != 0 || !S_ISREG(st.st_mode))
+            return nullptr;
+
+        size_t size = static_cast<size_t>(st.st_size);
+
+        uint64_t device = static_cast<uint64_t>(st.st_dev);
+        uint64_t inode = static_cast<uint64_t>(st.st_ino);
+
+        // The empty file can't be mapped, it just is a empty region.
+        if (size == 0)
+            return std::shared_ptr<const _MappedRegion>(new _MappedRegion(nullptr, 0, true, device, inode));
+
+        int flags = MAP_PRIVATE;
+        if (mode == LoadMode::MMAP_POPULATE)
+            flags |= MAP_POPULATE;
+
+        void* addr = ::mmap(nullptr, size, PROT_READ, flags, fd.get(), 0);
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+
+        if (addr == MAP_FAILED)
+            return nullptr;
+
+        if (mode == LoadMode::MMAP_SEQUENTIAL) {
+            ::madvise(addr, size, MADV_SEQUENTIAL);
+            ::madvise(addr, size, MADV_WILLNEED);
+        }
+
+        return std::shared_ptr<const _MappedRegion>(
+            new _MappedRegion(static_cast<const char*>(addr), size, true, device, inode));
+#else
+        (void) path;
+        (void) mode;
+        return nullptr;
+#endif // _BETTERFILE_LINUX
+    }
+
+    const char* data() const { return data_; }
+
+    size_t size() const { return size_; }
+
+    // @return If the region is a mapping of file return true, else it is a region of an arena.
+    bool isMapped() const { return isMapped_; }
+
+    // @return If the region is a mapping of the file (or a part of it) of the device and inode return true.
+    bool isMappingOf(uint64_t device, uint64_t inode) const
+    {
+        return isMapped_ && inode_ != 0 && device_ == device && inode_ == inode;
+    }
+
+private:
+    _MappedRegion(const char* data, size_t size, bool isMapped = true, uint64_t device = 0, uint64_t inode = 0) :
+        data_(data), size_(size), isMapped_(isMapped), device_(device), inode_(inode)
+    {}
+
+    const char* data_;
+    size_t size_;
+    bool isMapped_;
+    uint64_t device_;           // The device and inode of the mapped file, they are 0 if not mapped.
+    uint64_t inode_;
+};
+
+#ifdef _BETTERFILE_IO_URING
+
+// @brief A minimal io_uring instance by the raw system calls (without liburing).
+class _IoUring
+{
+public:
+    explicit _IoUring(uint entries)
+    {
+        io_uring_params params;
+        std::memset(&params, 0, sizeof(params));
+
+        fd_.reset(static_cast<int>(::syscall(SYS_io_uring_setup, entries, &params)));
+
+        if (!fd_.valid())
+            return;
+
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+        // The submission and completion rings share one mapping if the kernel supports.
+        isSingleMmap_ = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (isSingleMmap_)
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+
+        sqRing_ = map_(sqRingSize_, IORING_OFF_SQ_RING);
+        if (sqRing_ == nullptr)
+            return;
+
+        cqRing_ = isSingleMmap_ ? sqRing_ : map_(cqRingSize_, IORING_OFF_CQ_RING);
+        if (cqRing_ == nullptr)
+            return;
+
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        void* sqes = map_(sqesSize_, IORING_OFF_SQES);
+        if (sqes == nullptr)
+            return;
+
+        char* sq = static_cast<char*>(sqRing_);
+        sqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        sqEntries_ = params.sq_entries;
+        sqLocalTail_ = *sqTail_;
+
+        char* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+        sqes_ = static_cast<io_uring_sqe*>(sqes);
+    }
+
+    _IoUring(const _IoUring&) = delete;
+
+    _IoUring& operator=(const _IoUring&) = delete;
+
+    ~_IoUring()
+    {
+        if (sqes_)
+            ::munmap(sqes_, sqesSize_);
+        if (cqRing_ && cqRing_ != sqRing_)
+            ::munmap(cqRing_, cqRingSize_);
+        if (sqRing_)
+            ::munmap(sqRing_, sqRingSize_);
+    }
+
+    bool valid() const { return sqes_ != nullptr; }
+
+    // @return If all the operations are supported by the kernel return true.
+    bool isSupported(const Vec<uint>& opcodes) const
+    {
+        constexpr uint OPS_COUNT = 256;
+
+        Vec<char> buffer(sizeof(io_uring_probe) + OPS_COUNT * sizeof(io_uring_probe_op), 0);
+        auto probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+        if (::syscall(SYS_io_uring_register, fd_.get(), IORING_REGISTER_PROBE, probe, OPS_COUNT) != 0)
+            return false;
+
+        for (auto op : opcodes) {
+            if (op > probe->last_op || (probe->ops[op].flags & IO_URING_OP_SUPPORTED) == 0)
+                return false;
+        }
+
+        return true;
+    }
+
+    // @brief Register the buffers for the fixed read and write (IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED).
+    bool registerBuffers(const iovec* iovecs, uint count)
+    {
+        return ::syscall(SYS_io_uring_register, fd_.get(), IORING_REGISTER_BUFFERS, iovecs, count) == 0;
+    }
+
+    // @return The cleared submission entry, if the submission queue is full return nullptr.
+    io_uring_sqe* getSqe()
+    {
+        if (sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE) >= sqEntries_)
+            return nullptr;
+
+        unsigned index = sqLocalTail_ & sqMask_;
+        sqArray_[index] = index;
+        ++sqLocalTail_;
+
+        std::memset(&sqes_[index], 0, sizeof(io_uring_sqe));
+
+        return &sqes_[index];
+    }
+
+    // @brief Submit the queued entries and wait for at least one completion.
+    // @return If succeeded return true, else return false and the errno is set.
+    bool submitAndWait()
+    {
+        __atomic_store_n(sqTail_, sqLocalTail_, __ATOMIC_RELEASE);
+
+        while (true) {
+            // The entries not consumed by the kernel yet (include the rest of a partial submission).
+            unsigned count = unsubmitted();
+
+            if (::syscall(SYS_io_uring_enter, fd_.get(), count, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0)
+                return true;
+
+            // Retry if the kernel is short of resources temporarily.
+            if (errno == EAGAIN || errno == EBUSY)
+                std::this_thread::yield();
+            else if (errno != EINTR)
+                return false;
+        }
+    }
+
+    // @brief Wait for at least one completion without submitting the queued entries.
+    // @return If succeeded return true, else return false and the errno is set.
+    bool wait()
+    {
+        while (true) {
+            if (::syscall(SYS_io_uring_enter, fd_.get(), 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0)
+                return true;
+
+            if (errno != EINTR && errno != EAGAIN)
+                return false;
+        }
+    }
+
+    // @return The number of the queued entries which are not consumed by the kernel.
+    unsigned unsubmitted() const { return sqLocalTail_ - __atomic_load_n(sqHead_, __ATOMIC_ACQUIRE); }
+
+    // @brief Pop a completion entry.
+    // @return If the completion queue is empty return false.
+    bool popCqe(io_uring_cqe& cqe)
+    {
+        unsigned head = *cqHead_;
+
+        if (head == __atomic_load_n(cqTail_, __ATOMIC_ACQUIRE))
+            return false;
+
+        cqe = cqes_[head & cqMask_];
+        __atomic_store_n(cqHead_, head + 1, __ATOMIC_RELEASE);
+
+        return true;
+    }
+
+private:
+    void* map_(size_t size, off_t offset) const
+    {
+        void* addr = ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_.get(), offset);
+        return addr == MAP_FAILED ? nullptr : addr;
+    }
+
+    _Fd fd_;
+    bool isSingleMmap_ = false;
+
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+
+    io_uring_sqe* sqes_ = nullptr;
+    size_t sqesSize_ = 0;
+
+    unsigned* sqHead_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned* sqArray_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned sqEntries_ = 0;
+    unsigned sqLocalTail_ = 0;
+
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+#endif // _BETTERFILE_IO_URING
+
+// @brief A whole-file operation of #_runIoBatch.
+struct _IoTask
+{
+    enum Kind
+    {
+        READ,                       // Read the whole file to the out.
+        WRITE,                      // Write the data to the file (created or truncated).
+        COPY                        // Copy the data of the file to the dstPath (created or truncated).
+    };
+
+    Kind kind = READ;
+    String path;                    // The file to read or write, or the source file of copy.
+    String dstPath;                 // The destination file of copy.
+    String* out = nullptr;          // The string which the data read is stored to.
+    const char* data = nullptr;     // The data to write.
+    size_t size = 0;                // The size of the data to write.
+    uint mode = 0666;               // The mode of the created file (the copy uses the mode of the source).
+
+    // The state of the running task.
+    int stage = 0;
+    int fd = -1;
+    int dstFd = -1;
+    uint slot = 0;                  // The index of the buffer of copy.
+    size_t offset = 0;              // The file offset of next read or write.
+    size_t chunkSize = 0;           // The size of the chunk in the buffer of copy.
+    size_t chunkDone = 0;           // The size written of the chunk.
+};
+
+// @return If the io_uring and all the operations used by #_runIoBatch are supported return true.
+inline bool _isIoUringSupported()
+{
+#ifdef _BETTERFILE_IO_URING
+    _IoUring ring(1);
+
+    return ring.valid() && ring.isSupported({IORING_OP_OPENAT, IORING_OP_CLOSE, IORING_OP_READ, IORING_OP_WRITE,
+                                             IORING_OP_READ_FIXED, IORING_OP_WRITE_FIXED});
+#else
+    return false;
+#endif // _BETTERFILE_IO_URING
+}
+
+// @brief Run the tasks by io_uring. At most depth tasks are running at the same time, each running task
+// has one operation in flight, and the operations of all running tasks are submitted by one system call.
+// @return If the io_uring is not available return false and nothing is done. If failed to submit, the operations
+// in flight are drained and return false, the tasks are to be redone by the caller (some files may be written).
+// @note If a task failed, the running tasks are finished (the not started are not) and an exception is thrown.
+inline bool _runIoBatch(Vec<_IoTask>& tasks, uint depth = 64)
+{
+#ifdef _BETTERFILE_IO_URING
+    enum
+    {
+        OPEN,
+        OPEN_DST,
+        TRANSFER,       // Read or write the file (read a chunk for copy).
+        WRITE_CHUNK,    // Write the chunk of copy.
+        CLOSE,
+        CLOSE_DST,
+        DONE
+    };
+
+    // The max size of one read or write.
+    constexpr size_t MAX_IO_SIZE = size_t(1) << 30;
+
+    if (tasks.empty())
+        return true;
+
+    depth = static_cast<uint>(std::min<size_t>(std::max<uint>(depth, 1), tasks.size()));
+
+    _IoUring ring(depth);
+
+    if (!ring.valid())
+        return false;
+
+    // Each running copy task has its own chunk buffer, the buffers are registered once
+    // so the pages are not pinned by each operation. If failed to register, use the normal read and write.
+    bool hasCopy = std::any_of(tasks.begin(), tasks.end(), [](const _IoTask& t) { return t.kind == _IoTask::COPY; });
+    bool isFixed = false;
+    Vec<char> buffers;
+    Vec<uint> freeSlots;
+
+    if (hasCopy) {
+        buffers.resize(static_cast<size_t>(depth) * _LARGE_BUFFER_SIZE);
+        Vec<iovec> iovecs(depth);
+
+        for (uint i = 0; i < depth; ++i) {
+            iovecs[i].iov_base = buffers.data() + static_cast<size_t>(i) * _LARGE_BUFFER_SIZE;
+            iovecs[i].iov_len = _LARGE_BUFFER_SIZE;
+            freeSlots.push_back(i);
+        }
+
+        isFixed = ring.registerBuffers(iovecs.data(), depth);
+    }
+
+    auto queue = [&](_IoTask& task, size_t index) {
+        io_uring_sqe* sqe = ring.getSqe();
+
+        // The in flight operations are not more than the depth, so the submission queue is never full.
+        if (sqe == nullptr)
+            throw Exception("The io_uring submission queue is full.");
+
+        sqe->user_data = index;
+        char* buffer = buffers.data() + static_cast<size_t>(task.slot) * _LARGE_BUFFER_SIZE;
+
+        switch (task.stage) {
+            case OPEN:
+            case OPEN_DST:
+                sqe->opcode = IORING_OP_OPENAT;
+                sqe->fd = AT_FDCWD;
+                sqe->addr = reinterpret_cast<uintptr_t>(task.stage == OPEN ? task.path.c_str() : task.dstPath.c_str());
+                sqe->open_flags = (task.stage == OPEN && task.kind != _IoTask::WRITE) ?
+                    O_RDONLY | O_CLOEXEC : O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+                sqe->len = task.mode;
+                break;
+            case TRANSFER:
+                sqe->fd = task.fd;
+                sqe->off = task.offset;
+                if (task.kind == _IoTask::READ) {
+                    sqe->opcode = IORING_OP_READ;
+                    sqe->addr = reinterpret_cast<uintptr_t>(&(*task.out)[task.offset]);
+                    sqe->len = static_cast<unsigned>(std::min(task.out->size() - task.offset, MAX_IO_SIZE));
+                } else if (task.kind == _IoTask::WRITE) {
+                    sqe->opcode = IORING_OP_WRITE;
+                    sqe->addr = reinterpret_cast<uintptr_t>(task.data + task.offset);
+                    sqe->len = static_cast<unsigned>(std::min(task.size - task.offset, MAX_IO_SIZE));
+                } else {
+                    sqe->opcode = isFixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+                    sqe->addr = reinterpret_cast<uintptr_t>(buffer);
+                    sqe->len = _LARGE_BUFFER_SIZE;
+                    sqe->buf_index = static_cast<uint16_t>(task.slot);
+                }
+                break;
+            case WRITE_CHUNK:
+                sqe->opcode = isFixed ? IORING_OP_WRITE_FIXED : IORING_OP_WRITE;
+                sqe->fd = task.dstFd;
+                sqe->off = task.offset + task.chunkDone;
+                sqe->addr = reinterpret_cast<uintptr_t>(buffer + task.chunkDone);
+                sqe->len = static_cast<unsigned>(task.chunkSize - task.chunkDone);
+                sqe->buf_index = static_cast<uint16_t>(task.slot);
+                break;
+            case CLOSE:
+            case CLOSE_DST:
+                sqe->opcode = IORING_OP_CLOSE;
+                sqe->fd = task.stage == CLOSE ? task.fd : task.dstFd;
+                break;
+            default:
+                break;
+        }
+    };
+
+    // @return The error message if the operation failed, else advance the task to next stage.
+    auto complete = [&](_IoTask& task, int res) -> String {
+        const String& path = (task.stage == OPEN_DST || task.stage == WRITE_CHUNK || task.stage == CLOSE_DST) ?
+            task.dstPath : task.path;
+
+        // The errors of close are ignored as same as the synchronous way.
+        if (res < 0 && task.stage != CLOSE && task.stage != CLOSE_DST)
+            return _fmt("Failed to {} the file: \"{}\" ({})",
+                        task.stage == OPEN || task.stage == OPEN_DST ? "open" : "read or write", path,
+                        std::strerror(-res));
+
+        size_t n = res < 0 ? 0 : static_cast<size_t>(res);
+
+        switch (task.stage) {
+            case OPEN:
+                task.fd = res;
+                if (task.kind == _IoTask::COPY) {
+                    struct stat st;
+                    if (::fstat(res, &st) == 0)
+                        task.mode = st.st_mode & 07777;
+                    task.stage = OPEN_DST;
+                } else if (task.kind == _IoTask::READ) {
+                    // One more byte than the size, so the file grown after fstat is read without resizing.
+                    struct stat st;
+                    size_t size = ::fstat(res, &st) == 0 ? static_cast<size_t>(st.st_size) : 0;
+                    task.out->resize(size + 1);
+                    task.stage = TRANSFER;
+                } else {
+                    task.stage = task.size > 0 ? TRANSFER : CLOSE;
+                }
+                break;
+            case OPEN_DST:
+                task.dstFd = res;
+                task.stage = TRANSFER;
+                break;
+            case TRANSFER:
+                if (task.kind == _IoTask::READ) {
+                    // A short read is not the end of file (e.g. interrupted, or a pseudo file), only the empty one is.
+                    task.offset += n;
+
+                    if (n == 0) {
+                        task.out->resize(task.offset);
+                        task.stage = CLOSE;
+                    } else if (task.offset == task.out->size()) {
+                        // The file is larger than expected.
+                        task.out->resize(task.out->size() * 2);
+                    }
+                } else if (task.kind == _IoTask::WRITE) {
+                    if (n == 0)
+                        return _fmt("Failed to write the file: \"{}\" ({})", path, std::strerror(EIO));
+
+                    task.offset += n;
+                    if (task.offset == task.size)
+                        task.stage = CLOSE;
+                } else {
+                    task.chunkSize = n;
+                    task.chunkDone = 0;
+                    task.stage = n > 0 ? WRITE_CHUNK : CLOSE;
+                }
+                break;
+            case WRITE_CHUNK:
+                if (n == 0)
+                    return _fmt("Failed to write the file: \"{}\" ({})", path, std::strerror(EIO));
+
+                task.chunkDone += n;
+                if (task.chunkDone == task.chunkSize) {
+                    // Read the next chunk until the read returns 0.
+                    task.offset += task.chunkSize;
+                    task.stage = TRANSFER;
+                }
+                break;
+            case CLOSE:
+                task.fd = -1;
+                task.stage = task.kind == _IoTask::COPY ? CLOSE_DST : DONE;
+                break;
+            case CLOSE_DST:
+                task.dstFd = -1;
+                task.stage = DONE;
+                break;
+            default:
+                break;
+        }
+
+        return String();
+    };
+
+    // Close the descriptors of the task synchronously, when the task is stopped by a failure.
+    auto abort = [](_IoTask& task, int res) {
+        if (task.stage == OPEN && res >= 0)
+            task.fd = res;
+        if (task.stage == OPEN_DST && res >= 0)
+            task.dstFd = res;
+        if (task.stage == CLOSE)
+            task.fd = -1;
+        if (task.stage == CLOSE_DST)
+            task.dstFd = -1;
+
+        if (task.fd >= 0)
+            ::close(task.fd);
+        if (task.dstFd >= 0)
+            ::close(task.dstFd);
+
+        task.fd = task.dstFd = -1;
+        task.stage = DONE;
+    };
+
+    String error;
+    size_t next = 0;
+    size_t running = 0;
+
+    while (true) {
+        while (error.empty() && next < tasks.size() && running < depth) {
+            _IoTask& task = tasks[next];
+            task.stage = OPEN;
+
+            if (task.kind == _IoTask::COPY) {
+                task.slot = freeSlots.back();
+                freeSlots.pop_back();
+            }
+
+            queue(task, next);
+            ++next;
+            ++running;
+        }
+
+        if (running == 0)
+            break;
+
+        if (!ring.submitAndWait()) {
+            // The submitted operations must be finished before the buffers are released, so drain them.
+            // If failed to wait too, the completion queue is polled (the operations complete anyway).
+            size_t inFlight = running - ring.unsubmitted();
+            bool isWaitable = true;
+
+            io_uring_cqe cqe;
+            while (inFlight > 0) {
+                if (ring.popCqe(cqe)) {
+                    abort(tasks[static_cast<size_t>(cqe.user_data)], cqe.res);
+                    --inFlight;
+                } else if (!isWaitable || !(isWaitable = ring.wait())) {
+                    std::this_thread::yield();
+                }
+            }
+
+            // The tasks whose operations are not submitted are stopped too.
+            for (size_t i = 0; i < next; ++i) {
+                if (tasks[i].stage != DONE)
+                    abort(tasks[i], -1);
+            }
+
+            if (!error.empty())
+                throw Exception(error);
+
+            return false;
+        }
+
+        io_uring_cqe cqe;
+        while (ring.popCqe(cqe)) {
+            size_t index = static_cast<size_t>(cqe.user_data);
+            _IoTask& task = tasks[index];
+
+            if (error.empty())
+                error = complete(task, cqe.res);
+
+            if (!error.empty())
+                abort(task, cqe.res);
+
+            if (task.stage != DONE) {
+                queue(task, index);
+                continue;
+            }
+
+            if (task.kind == _IoTask::COPY)
+                freeSlots.push_back(task.slot);
+
+            --running;
+        }
+    }
+
+    if (!error.empty())
+        throw Exception(error);
+
+    return true;
+#else
+    (void) tasks;
+    (void) depth;
+    return false;
+#endif // _BETTERFILE_IO_URING
+}
+
+} // namespace btf
+
+// Concurrency utilities.
+namespace btf
+{
+
+// @brief A fixed size thread pool with per-worker task queues and work stealing.
+// Tasks submitted from a worker thread are pushed to the worker's own queue (LIFO),
+// idle workers steal the oldest task from the other queues (FIFO), so deep subtrees
+// spawned by one task are spread over all workers.
+class _WorkStealingPool
+{
+public:
+    using Task = std::function<void()>;
+
+    // @param threadCount The number of workers, 0 means the hardware concurrency.
+    explicit _WorkStealingPool(uint threadCount = 0)
+    {
+        if (threadCount == 0)
+            threadCount = hardwareConcurrency();
+
+        for (uint i = 0; i < threadCount; ++i)
+            queues_.emplace_back(new Queue_());
+
+        for (uint i = 0; i < threadCount; ++i)
+            threads_.emplace_back(&_WorkStealingPool::run_, this, i);
+    }
+
+    _WorkStealingPool(const _WorkStealingPool&) = delete;
+
+    _WorkStealingPool& operator=(const _WorkStealingPool&) = delete;
+
+    ~_WorkStealingPool()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+
+        for (auto& var : threads_)
+            var.join();
+    }
+
+    static uint hardwareConcurrency()
+    {
+        uint cnt = std::thread::hardware_concurrency();
+        return cnt == 0 ? 1 : cnt;
+    }
+
+    size_t threadCount() const { return threads_.size(); }
+
+    void submit(Task task)
+    {
+        size_t index = currentIndex_();
+        if (index == NOF_)
+            index = next_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+        pending_.fetch_add(1, std::memory_order_relaxed);
+
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mtx);
+            queues_[index]->tasks.emplace_back(std::move(task));
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            ++queued_;
+        }
+        cv_.notify_one();
+    }
+
+    // @brief Block until all submitted tasks (include the tasks submitted by tasks) are finished.
+    // @note If any task throws, the first exception is rethrown here.
+    void wait()
+    {
+        std::unique_lock<std::mutex> lock(mtx_);
+        doneCv_.wait(lock, [this]() { return pending_.load() == 0; });
+
+        if (error_) {
+            std::exception_ptr error = error_;
+            error_ = nullptr;
+            std::rethrow_exception(error);
+        }
+    }
+
+private:
+    static constexpr size_t NOF_ = size_t(-1);
+
+    struct Queue_
+    {
+        std::mutex mtx;
+        std::deque<Task> tasks;
+    };
+
+    // The index of the worker of this pool which the current thread is, or NOF_.
+    size_t currentIndex_() const
+    {
+        if (workerPool_() != this)
+            return NOF_;
+        return workerIndex_();
+    }
+
+    static const _WorkStealingPool*& workerPool_()
+    {
+        static thread_local const _WorkStealingPool* pool = nullptr;
+        return pool;
+    }
+
+    static size_t& workerIndex_()
+    {
+        static thread_local size_t index = NOF_;
+        return index;
+    }
+
+    bool pop_(size_t index, Task& task)
+    {
+        // Own queue first, newest task.
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mtx);
+            if (!queues_[index]->tasks.empty()) {
+                task = std::move(queues_[index]->tasks.back());
+                queues_[index]->tasks.pop_back();
+                return true;
+            }
+        }
+
+        // Steal the oldest task from the others.
+        for (size_t i = 1; i < queues_.size(); ++i) {
+            Queue_& queue = *queues_[(index + i) % queues_.size()];
+            std::lock_guard<std::mutex> lock(queue.mtx);
+            if (!queue.tasks.empty()) {
+                task = std::move(queue.tasks.front());
+                queue.tasks.pop_front();
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    void run_(size_t index)
+    {
+        workerPool_() = this;
+        workerIndex_() = index;
+
+        while (true) {
+            Task task;
+
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this]() { return stop_ || queued_ > 0; });
+
+                if (stop_ && queued_ == 0)
+                    return;
+            }
+
+            if (!pop_(index, task))
+                continue;
+
+            {
+                std::lock_guard<std::mutex> lock(mtx_);
+                --queued_;
+            }
+
+            try {
+                task();
+            } catch (...) {
+                std::lock_guard<std::mutex> lock(mtx_);
+                if (!error_)
+                    error_ = std::current_exception();
+            }
+
+            if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+                std::lock_guard<std::mutex> lock(mtx_);
+                doneCv_.notify_all();
+            }
+        }
+    }
+
+    Vec<std::unique_ptr<Queue_>> queues_;
+    Vec<std::thread> threads_;
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::condition_variable doneCv_;
+    size_t queued_ = 0;
+    bool stop_ = false;
+    std::atomic<size_t> pending_{0};
+    std::atomic<size_t> next_{0};
+    std::exception_ptr error_;
+};
+
+// @brief A counting budget of bytes, the acquire blocks until the bytes in use plus the acquired
+// are not more than the limit. A request larger than the limit is granted when nothing is in use.
+class _ByteBudget
+{
+public:
+    // @brief Acquire the bytes in the scope.
+    class Guard
+    {
+    public:
+        Guard(_ByteBudget& budget, size_t bytes) : budget_(budget), bytes_(bytes) { budget_.acquire(bytes_); }
+
+        Guard(const Guard&) = delete;
+
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard() { budget_.release(bytes_); }
+
+    private:
+        _ByteBudget& budget_;
+        size_t bytes_;
+    };
+
+    explicit _ByteBudget(size_t limit) : limit_(limit) {}
+
+    void acquire(size_t bytes)
+    {
+        if (bytes == 0)
+            return;
+
+        std::unique_lock<std::mutex> lock(mtx_);
+        cv_.wait(lock, [this, bytes]() { return used_ == 0 || used_ + bytes <= limit_; });
+        used_ += bytes;
+    }
+
+    void release(size_t bytes)
+    {
+        if (bytes == 0)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            used_ -= bytes;
+        }
+        cv_.notify_all();
+    }
+
+private:
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    size_t limit_;
+    size_t used_ = 0;
+};
+
+} // namespace btf
+
+#ifdef _BETTERFILE_CPP17
+#ifndef BTF_FWD
+#include <filesystem>
+namespace btf
+{
+
+namespace fs = std::filesystem;
+
+}
+#endif // !BTF_FWD
+#else
+#ifndef BTF_FWD
+#include <ghc/filesystem.hpp>
+namespace btf
+{
+
+namespace fs = ghc::filesystem;
+
+}
+#endif // !BTF_FWD
+#endif // _BETTERFILE_CPP17
+
+// Declaration of utility functions with filesystem.
+namespace btf
+{
+
+#ifndef BTF_IMPL
+
+class Entry;
+
+BTF_API String normalize(const String& path);
+
+BTF_API String currentPath();
+
+// @example "C:/path/to/file.txt" -> "C:/path/to"
+BTF_API String parentPath(const String& path);
+
+// @example "C:/path/to/file.txt" -> "to"
+BTF_API String parentName(const String& path);
+
+// @example "C:/path/to/file.txt" -> "file.txt"
+BTF_API String filenameEx(const String& path);
+
+// @example "C:/path/to/file.txt" -> "file"
+BTF_API String filename(const String& path);
+
+// @example "C:/path/to/file.txt" -> ".txt"
+BTF_API String extension(const String& path);
+
+BTF_API bool isExists(const String& path);
+
+// @return If the path is exists and path target is a regular file return true, else return false.
+BTF_API bool isFile(const String& path);
+
+// @return If the path is exists and path target is a directory return true, else return false.
+BTF_API bool isDirectory(const String& path);
+
+// @return If the path is exists and path target is a symlink return true, else return false.
+BTF_API bool isSymlink(const String& path);
+
+// @return If the path is a empty file or directory return true, else return false.
+// @note If the path is not exists, throw exception.
+BTF_API bool isEmpty(const String& path);
+
+BTF_API bool isSubPath(const String& path, const String& base);
+
+BTF_API bool isRelative(const String& path);
+
+BTF_API bool isAbsolute(const String& path);
+
+// @brief Get the relative path from the base path.
+BTF_API String relative(const String& path, const String& base = currentPath());
+
+BTF_API String absolute(const String& path);
+
+BTF_API bool isEqualPath(const String& path1, const String& path2);
+
+// @brief Check if filesystem entity (file, directory, symlink, hardlink) of two paths is same one.
+BTF_API bool isSameFileSystemEntity(const String& path1, const String& path2);
+
+// @return The size of the file or directory.
+BTF_API size_t sizes(const String& path);
+
+// @brief Get the disk usage like "du", the subtrees are walked by a pool of workers.
+// Unlike #sizes, the symlinks in the tree are not followed and the hardlinks of a file are counted once
+// (by device and inode). The path itself is followed if it is a symlink to a file or directory.
+// @param threadCount The number of workers, 0 means the hardware concurrency.
+// @param dirUsages If it is not null, it is filled with the total usage of each directory (include the root).
+BTF_API DiskUsage diskUsage(const String& path, uint threadCount = 0, std::map<String, DiskUsage>* dirUsages = nullptr);
+
+// @return The content hash of the file (same as #hash64 of its data), the file is read by chunks.
+BTF_API uint64_t hashFile(const String& path);
+
+// @brief Get the Merkle digest of the file or directory, the digest of a directory is the hash of the names,
+// types and digests of its children (sorted by name), so two trees have the same digest if their contents are same.
+// The directorys are enumerated and the files are hashed by a pool of workers, the symlinks to file are followed,
+// but a symlink to directory is not descended, it is hashed as a file whose data is the target path.
+// The result is same as #Dir::digest of the tree loaded from the path if the tree has no symlinks to directory.
+// @param threadCount The number of workers, 0 means the hardware concurrency.
+// @param dirDigests If it is not null, it is filled with the digest of each directory (include the root).
+BTF_API uint64_t digest(const String& path, uint threadCount = 0, std::map<String, uint64_t>* dirDigests = nullptr);
+
+// @brief Create a directory.
+// @return If the directory is existed return false.
+// @note The parent directory must exists.
+BTF_API bool createDirectory(const String& path);
+
+// @brief Create a directory tree.
+// @return If the directory is existed return false.
+// @note The parent directory can be not exists (create it automatically).
+BTF_API bool createDirectorys(const String& path);
+
+// @return The number of files and directories deleted.
+// @param threadCount The number of workers of #parallelDeletes, 0 means the hardware concurrency.
+// @note On linux the small directory tree is deleted serially, the large one by #parallelDeletes.
+BTF_API size_t deletes(const String& path, uint threadCount = 0);
+
+// @brief Delete the file or directory tree by a pool of workers, each directory is read by its descriptor and
+// the entries are unlinked relative to it, the directories are deleted bottom-up when their children are deleted.
+// The symlinks are deleted (not followed).
+// @param threadCount The number of workers, 0 means the hardware concurrency.
+// @param onProgress If it is not null, it is called with the number of entries deleted so far,
+// it is called by the workers (not concurrently) and at last by the caller thread with the total.
+// @return The number of files and directories deleted, same as #deletes.
+BTF_API size_t parallelDeletes(const String& path, uint threadCount = 0,
+                               const std::function<void(size_t)>& onProgress = nullptr);
+
+// @brief Rename the path aside (to a temporary sibling) and delete it by #parallelDeletes in a background thread,
+// so the path is free immediately. The deletes of all calls are run one by one by a shared background thread,
+// and the deletes not finished are waited at the normal exit of process (the destruction of the static objects).
+// @return The future of the number of entries deleted.
+// @note If the process is killed (or exits by std::quick_exit or _exit) before the delete is finished,
+// the rest is left on disk as the hidden sibling ".btf-<pid>-<n>.tmp" of the path, it is never deleted by betterfile.
+BTF_API std::future<size_t> deletesInBackground(const String& path, uint threadCount = 0);
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite = false);
+
+// @brief Same as #copy, the metadata of source which is already read (e.g. by #Walker::entry) is not read again.
+BTF_API void copy(const Entry& src, const String& dst, bool isOverwrite = false);
+
+// @brief Same as #copy, and the strategy of each file is reported.
+// @param onFile It is called for each file after it is copied (or skipped).
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, const CopyCallback& onFile);
+
+// @brief Same as #copy, and the files of the directory are copied by the specified I/O backend.
+// @note The files copied by IoBackend::IO_URING are read and written by the user-space buffers
+// (not cloned or copied in kernel).
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, IoBackend backend);
+
+// @brief Copy the data of a regular file, the destination is created or truncated.
+// On linux the kernel-side strategies are tried in order: reflink (FICLONE), copy_file_range, sendfile,
+// and a user-space buffered loop is the last fallback.
+// @return The strategy which finished the copy.
+BTF_API CopyStrategy copyFileData(const String& src, const String& dst);
+
+// @brief Copy a regular file with the same overwrite and skip rules as #copy.
+// @return The strategy used, if the file is skipped return CopyStrategy::NONE.
+BTF_API CopyStrategy copyFile(const String& src, const String& dst, bool isOverwrite = false);
+
+BTF_API CopyStrategy copyFile(const Entry& src, const String& dst, bool isOverwrite = false);
+
+// @brief Write the data to the file, the file is created or truncated.
+BTF_API void writeFile(const String& path, const char* data, size_t size);
+
+// @brief Copy the file or directory by a pool of workers.
+// The directory enumeration and the file copying are split into separate tasks,
+// the overwrite and skip rules are same as #copy.
+// @param threadCount The number of workers, 0 means the hardware concurrency.
+// @param onFile If it is not null, it is called for each file after it is copied (or skipped),
+// it is called by the workers concurrently, so it must be thread-safe.
+// @return The statistics of the copy.
+BTF_API CopyStats parallelCopy(const String& src, const String& dst, bool isOverwrite = false, uint threadCount = 0,
+                               const CopyCallback& onFile = nullptr);
+
+// @brief Make the destination a mirror of the source incrementally, only the new and changed files are copied.
+// A file is unchanged if the destination is a file of same size and same mtime (or, if their mtimes are
+// different, same content hash, see #SyncOptions::isCompareHash). The destination entries of different type are replaced.
+// @note Same as #copy, the symlinks to directory are not descended (just create the directory).
+// @return The statistics of the mirror.
+BTF_API SyncStats mirror(const String& src, const String& dst, const SyncOptions& options = SyncOptions());
+
+BTF_API void copySymlink(const String& src, const String& dst, bool isOverwrite = false);
+
+BTF_API void move(const String& src, const String& dst, bool isOverwrite = false);
+
+BTF_API void move(const Entry& src, const String& dst, bool isOverwrite = false);
+
+BTF_API void reFilename(const String& path, const String& newFilename, bool isOverwrite = false);
+
+BTF_API void reFilenameEx(const String& path, const String& newFilenameEx, bool isOverwrite = false);
+
+BTF_API void reExtension(const String& path, const String& newExtension, bool isOverwrite = false);
+
+BTF_API void createSymlink(const String& src, const String& dst, bool isOverwrite = false);
+
+BTF_API void createSymlink(const Entry& src, const String& dst, bool isOverwrite = false);
+
+BTF_API String symlinkTarget(const String& path);
+
+BTF_API void createHardlink(const String& src, const String& dst, bool isOverwrite = false);
+
+BTF_API void createHardlink(const Entry& src, const String& dst, bool isOverwrite = false);
+
+BTF_API size_t hardlinkCount(const String& path);
+
+BTF_API String tempDirectory();
+
+// @return If the io_uring and the operations it needs are supported by the kernel (and not disabled
+// by BTF_NO_IO_URING) return true. The result is detected once.
+BTF_API bool isIoUringAvailable();
+
+// @return The pair of files and drietorys.
+BTF_API std::pair<Strings, Strings>
+getAlls(const String& path, bool isRecursive = true, bool (*filter)(const String&) = nullptr);
+
+BTF_API Strings getAllFiles(const String& path, bool isRecursive = true, bool (*filter)(const String&) = nullptr);
+
+BTF_API Strings getAllDirectorys(const String& path, bool isRecursive = true, bool (*filter)(const String&) = nullptr);
+
+// The non-throwing overloads, they are same as above but the failure is reported by ec (cleared if succeeded)
+// rather than thrown. The common failures (e.g. the path not exists) are detected without any exception inside,
+// and the message is only formatted when ec.message() is called. The errors detected by betterfile are #Errc,
+// the others are the errors of the system (or std::errc::not_enough_memory).
+// @note As the throwing overloads, the path which not exists is not a failure of the queries (e.g. #isFile)
+// and #deletes.
+
+BTF_API String currentPath(std::error_code& ec) noexcept;
+
+BTF_API bool isExists(const String& path, std::error_code& ec) noexcept;
+
+BTF_API bool isFile(const String& path, std::error_code& ec) noexcept;
+
+BTF_API bool isDirectory(const String& path, std::error_code& ec) noexcept;
+
+BTF_API bool isSymlink(const String& path, std::error_code& ec) noexcept;
+
+BTF_API bool isEmpty(const String& path, std::error_code& ec) noexcept;
+
+BTF_API String relative(const String& path, const String& base, std::error_code& ec) noexcept;
+
+BTF_API String absolute(const String& path, std::error_code& ec) noexcept;
+
+BTF_API bool isSameFileSystemEntity(const String& path1, const String& path2, std::error_code& ec) noexcept;
+
+BTF_API size_t sizes(const String& path, std::error_code& ec) noexcept;
+
+BTF_API DiskUsage diskUsage(const String& path, uint threadCount, std::map<String, DiskUsage>* dirUsages,
+                            std::error_code& ec) noexcept;
+
+BTF_API uint64_t hashFile(const String& path, std::error_code& ec) noexcept;
+
+BTF_API uint64_t digest(const String& path, uint threadCount, std::map<String, uint64_t>* dirDigests,
+                        std::error_code& ec) noexcept;
+
+BTF_API bool createDirectory(const String& path, std::error_code& ec) noexcept;
+
+BTF_API bool createDirectorys(const String& path, std::error_code& ec) noexcept;
+
+BTF_API size_t deletes(const String& path, std::error_code& ec) noexcept;
+
+BTF_API size_t deletes(const String& path, uint threadCount, std::error_code& ec) noexcept;
+
+BTF_API size_t parallelDeletes(const String& path, uint threadCount, const std::function<void(size_t)>& onProgress,
+                               std::error_code& ec) noexcept;
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API void copy(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, const CopyCallback& onFile,
+                  std::error_code& ec) noexcept;
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, IoBackend backend,
+                  std::error_code& ec) noexcept;
+
+BTF_API CopyStrategy copyFileData(const String& src, const String& dst, std::error_code& ec) noexcept;
+
+BTF_API CopyStrategy copyFile(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API CopyStrategy copyFile(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API void writeFile(const String& path, const char* data, size_t size, std::error_code& ec) noexcept;
+
+BTF_API CopyStats parallelCopy(const String& src, const String& dst, bool isOverwrite, uint threadCount,
+                               std::error_code& ec) noexcept;
+
+BTF_API CopyStats parallelCopy(const String& src, const String& dst, bool isOverwrite, uint threadCount,
+                               const CopyCallback& onFile, std::error_code& ec) noexcept;
+
+BTF_API SyncStats mirror(const String& src, const String& dst, const SyncOptions& options,
+                         std::error_code& ec) noexcept;
+
+BTF_API void copySymlink(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API void move(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API void move(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API void reFilename(const String& path, const String& newFilename, bool isOverwrite,
+                        std::error_code& ec) noexcept;
+
+BTF_API void reFilenameEx(const String& path, const String& newFilenameEx, bool isOverwrite,
+                          std::error_code& ec) noexcept;
+
+BTF_API void reExtension(const String& path, const String& newExtension, bool isOverwrite,
+                         std::error_code& ec) noexcept;
+
+BTF_API void createSymlink(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API void createSymlink(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API String symlinkTarget(const String& path, std::error_code& ec) noexcept;
+
+BTF_API void createHardlink(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API void createHardlink(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept;
+
+BTF_API size_t hardlinkCount(const String& path, std::error_code& ec) noexcept;
+
+BTF_API String tempDirectory(std::error_code& ec) noexcept;
+
+BTF_API std::pair<Strings, Strings>
+getAlls(const String& path, bool isRecursive, bool (*filter)(const String&), std::error_code& ec) noexcept;
+
+BTF_API Strings getAllFiles(const String& path, bool isRecursive, bool (*filter)(const String&),
+                            std::error_code& ec) noexcept;
+
+BTF_API Strings getAllDirectorys(const String& path, bool isRecursive, bool (*filter)(const String&),
+                                 std::error_code& ec) noexcept;
+
+#endif // !BTF_IMPL
+
+} // namespace btf
+
+// Streaming traversal.
+namespace btf
+{
+
+// The low-level directory stream used by #Walker, the stream is an opaque handle.
+// On linux it reads the entries by getdents64 and resolves the children relative to the directory descriptor.
+// @note The "." and ".." are not read, and the type of symlink is the type of its target.
+BTF_API void* _openDirStream(const String& path);
+
+// @brief Open the child directory of the parent stream (relative to it if the platform supports).
+// @param path The full path of the child, for the error message and the fallback.
+BTF_API void* _openDirStreamAt(void* parent, const String& name, const String& path);
+
+// @return If the stream has no more entries return false.
+BTF_API bool _readDirStream(void* stream, String& name, EntryType& type, bool& isSymlink);
+
+// @return The size of the regular file entry of the stream.
+BTF_API size_t _dirStreamEntrySize(void* stream, const String& name, const String& path);
+
+BTF_API void _closeDirStream(void* stream);
+
+// The metadata of a path read by #_statEntry.
+struct _EntryStat
+{
+    EntryType type = EntryType::NONE;   // The type of the target if it is a symlink.
+    bool isSymlink = false;
+    size_t size = 0;                    // The size if it is a regular file, else 0.
+    int64_t mtime = 0;                  // The nanoseconds since the epoch of the filesystem clock.
+    uint64_t inode = 0;                 // The inode and the device are 0 if the platform has not them.
+    uint64_t device = 0;
+};
+
+// @brief Read the metadata of the path by lstat, and by stat only if it is a symlink (for its target).
+// @return The error of the stat, the path (or the target of symlink) which not exists is not an error,
+// its type is EntryType::NONE.
+BTF_API std::error_code _statEntry(const String& path, _EntryStat& out);
+
+// @brief The metadata of a path (type, size, mtime, inode and device), it is read by one stat when it is accessed
+// first and then cached, so an operation checks the path many times but stats it once.
+// The entries produced by #Walker::entry have the type already (read from the directory), they need no stat
+// until the other metadata is accessed.
+// @note Same as the std::filesystem, the metadata is of the symlink target, except #isSymlink.
+// The metadata is not updated if the path is changed after it is read, see #refresh.
+class Entry
+{
+public:
+    Entry() = default;
+
+    explicit Entry(const String& path) : path_(path) {}
+
+    // @brief The entry whose type is known, e.g. read from the directory.
+    Entry(const String& path, EntryType type, bool isSymlink) : path_(path), isTyped_(true)
+    {
+        stat_.type = type;
+        stat_.isSymlink = isSymlink;
+    }
+
+    const String& path() const { return path_; }
+
+    // @return The type of the entry, the type of symlink is the type of its target.
+    // If the path not exists (or the stat is failed, see #error) return EntryType::NONE.
+    EntryType type() const
+    {
+        if (!isTyped_)
+            load_();
+        return stat_.type;
+    }
+
+    bool isExists() const { return type() != EntryType::NONE; }
+
+    bool isFile() const { return type() == EntryType::FILE; }
+
+    bool isDirectory() const { return type() == EntryType::DIRECTORY; }
+
+    bool isSymlink() const
+    {
+        if (!isTyped_)
+            load_();
+        return stat_.isSymlink;
+    }
+
+    // @return The size if it is a regular file, else return 0.
+    size_t size() const { return loaded_().size; }
+
+    // @return The last modification time, the nanoseconds since the epoch of the filesystem clock.
+    int64_t mtime() const { return loaded_().mtime; }
+
+    uint64_t inode() const { return loaded_().inode; }
+
+    uint64_t device() const { return loaded_().device; }
+
+    // @return The error of the stat (e.g. the permission denied), the path which not exists is not an error.
+    const std::error_code& error() const
+    {
+        if (!isTyped_)
+            load_();
+        return error_;
+    }
+
+    // @brief Discard the cached metadata, it is read again when accessed.
+    void refresh()
+    {
+        stat_ = _EntryStat();
+        error_.clear();
+        isTyped_ = false;
+        isLoaded_ = false;
+    }
+
+private:
+    const _EntryStat& loaded_() const
+    {
+        if (!isLoaded_)
+            load_();
+        return stat_;
+    }
+
+    void load_() const
+    {
+        error_ = _statEntry(path_, stat_);
+        isTyped_ = true;
+        isLoaded_ = true;
+    }
+
+    String path_;
+    mutable _EntryStat stat_;
+    mutable std::error_code error_;
+    mutable bool isTyped_ = false;
+    mutable bool isLoaded_ = false;
+};
+
+// @brief The streaming traversal of a directory, the entries are produced while walking (pre-order),
+// and the memory is constant no matter how big the tree is (except the depth).
+// The current entry is accessed by the walker itself, and its path is a reused buffer.
+//
+// @example
+// for (const auto& var : Walker(path))
+//     if (var.isFile())
+//         std::cout << var.path() << " " << var.size() << std::endl;
+class Walker
+{
+public:
+    // @brief The input iterator of the entries, it is the walker itself.
+    class Iterator
+    {
+    public:
+        explicit Iterator(Walker* walker = nullptr) : walker_(walker) {}
+
+        const Walker& operator*() const { return *walker_; }
+
+        const Walker* operator->() const { return walker_; }
+
+        Iterator& operator++()
+        {
+            if (!walker_->next())
+                walker_ = nullptr;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const { return walker_ == other.walker_; }
+
+        bool operator!=(const Iterator& other) const { return walker_ != other.walker_; }
+
+    private:
+        Walker* walker_;
+    };
+
+    // @note If the path is not a directory or can't be opened, throw exception.
+    explicit Walker(const String& path, bool isRecursive = true) : path_(path), isRecursive_(isRecursive)
+    {
+        if (path_.empty() || (path_.back() != WIN_PATH_SEPARATOR && path_.back() != LINUX_PATH_SEPARATOR))
+            path_.push_back(PREFERRED_PATH_SEPARATOR);
+
+        streams_.push_back(_openDirStream(path));
+        prefixes_.push_back(path_.size());
+    }
+
+    Walker(const Walker&) = delete;
+
+    Walker& operator=(const Walker&) = delete;
+
+    ~Walker()
+    {
+        for (auto var : streams_)
+            _closeDirStream(var);
+    }
+
+    // @brief Advance to the next entry.
+    // @return If there are no more entries return false.
+    bool next()
+    {
+        if (isDescend_) {
+            isDescend_ = false;
+
+            streams_.push_back(_openDirStreamAt(streams_.back(), name_, path_));
+            path_.push_back(PREFERRED_PATH_SEPARATOR);
+            prefixes_.push_back(path_.size());
+        }
+
+        while (!streams_.empty()) {
+            if (_readDirStream(streams_.back(), name_, type_, isSymlink_)) {
+                path_.resize(prefixes_.back());
+                path_.append(name_);
+                hasSize_ = false;
+
+                // Same as the std::filesystem, the symlink to directory is not followed.
+                isDescend_ = isRecursive_ && type_ == EntryType::DIRECTORY && !isSymlink_;
+
+                return true;
+            }
+
+            _closeDirStream(streams_.back());
+            streams_.pop_back();
+            prefixes_.pop_back();
+        }
+
+        return false;
+    }
+
+    // @brief Don't descend into the current directory.
+    void skip() { isDescend_ = false; }
+
+    // @return The path of the current entry, it is valid until the next advance.
+    const String& path() const { return path_; }
+
+    // @return The filename of the current entry, it is valid until the next advance.
+    const String& name() const { return name_; }
+
+    // @return The type of the current entry, the type of symlink is the type of its target.
+    EntryType type() const { return type_; }
+
+    bool isFile() const { return type_ == EntryType::FILE; }
+
+    bool isDirectory() const { return type_ == EntryType::DIRECTORY; }
+
+    bool isSymlink() const { return isSymlink_; }
+
+    // @return The #Entry of the current entry, its type is known without stat.
+    Entry entry() const { return Entry(path_, type_, isSymlink_); }
+
+    // @return The depth of the current entry, the entries in the walked directory are depth 0.
+    size_t depth() const { return streams_.size() - 1; }
+
+    // @return The size of the current entry if it is a regular file, else return 0.
+    // @note The size is queried when it is called first for each entry.
+    size_t size() const
+    {
+        if (!hasSize_) {
+            size_ = type_ == EntryType::FILE ? _dirStreamEntrySize(streams_.back(), name_, path_) : 0;
+            hasSize_ = true;
+        }
+
+        return size_;
+    }
+
+    Iterator begin()
+    {
+        if (!next())
+            return end();
+        return Iterator(this);
+    }
+
+    Iterator end() { return Iterator(); }
+
+private:
+    Vec<void*> streams_;
+    Vec<size_t> prefixes_;  // The path length of the directory (include the trailing separator) of each stream.
+    String path_;
+    String name_;
+    EntryType type_ = EntryType::NONE;
+    bool isSymlink_ = false;
+    bool isDescend_ = false;
+    bool isRecursive_;
+    mutable bool hasSize_ = false;
+    mutable size_t size_ = 0;
+};
+
+template <typename Visitor>
+WalkAction _visit(Visitor& visitor, const Walker& walker, std::true_type /* isVoid */)
+{
+    visitor(walker);
+    return WalkAction::CONTINUE;
+}
+
+template <typename Visitor>
+WalkAction _visit(Visitor& visitor, const Walker& walker, std::false_type /* isVoid */)
+{
+    return visitor(walker);
+}
+
+// @brief Visit the entries under the path while walking, the visitor and the filter are inlinable.
+// @param visitor Called as visitor(const Walker&) for each entry passed the filter, it returns the #WalkAction
+// (WalkAction::SKIP means don't descend into the directory, WalkAction::STOP means stop the walk) or void.
+// @param filter Called as filter(const Walker&) returns bool, the rejected directory is still descended.
+template <typename Visitor, typename Filter>
+void walk(const String& path, Visitor&& visitor, Filter&& filter, bool isRecursive = true)
+{
+    using IsVoid = std::is_void<decltype(visitor(std::declval<const Walker&>()))>;
+
+    Walker walker(path, isRecursive);
+
+    while (walker.next()) {
+        if (!filter(static_cast<const Walker&>(walker)))
+            continue;
+
+        WalkAction action = _visit(visitor, walker, IsVoid());
+
+        if (action == WalkAction::STOP)
+            return;
+
+        if (action == WalkAction::SKIP)
+            walker.skip();
+    }
+}
+
+template <typename Visitor>
+void walk(const String& path, Visitor&& visitor, bool isRecursive = true)
+{
+    walk(path, std::forward<Visitor>(visitor), [](const Walker&) { return true; }, isRecursive);
+}
+
+} // namespace btf
+
+// Implementation of utility functions with filesystem.
+namespace btf
+{
+
+#ifndef BTF_FWD
+
+using _pth = fs::path;
+
+// @return The status of the path, the path which not exists is not an error (same as std::filesystem::exists).
+// @param isFollow If false, the status of the symlink itself.
+BTF_API fs::file_status _status(const String& path, std::error_code& ec, bool isFollow = true) noexcept
+{
+    fs::file_status status = isFollow ? fs::status(path, ec) : fs::symlink_status(path, ec);
+
+    if (status.type() != fs::file_type::none)
+        ec.clear();
+
+    return status;
+}
+
+BTF_API std::error_code _statEntry(const String& path, _EntryStat& out)
+{
+    out = _EntryStat();
+
+#ifdef _BETTERFILE_LINUX
+    struct stat st;
+
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+    if (::lstat(path.c_str(), &st) != 0)
+        return errno == ENOENT || errno == ENOTDIR ? std::error_code() : _lastError();
+
+    if (S_ISLNK(st.st_mode)) {
+        out.isSymlink = true;
+
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+        if (::stat(path.c_str(), &st) != 0)
+            return errno == ENOENT || errno == ENOTDIR ? std::error_code() : _lastError();
+    }
+
+    out.type = S_ISREG(st.st_mode) ? EntryType::FILE : S_ISDIR(st.st_mode) ? EntryType::DIRECTORY : EntryType::OTHER;
+    out.size = out.type == EntryType::FILE ? static_cast<size_t>(st.st_size) : 0;
+    out.mtime = static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+    out.inode = static_cast<uint64_t>(st.st_ino);
+    out.device = static_cast<uint64_t>(st.st_dev);
+#else
+    std::error_code ec;
+    fs::file_status status = _status(path, ec, false);
+
+    if (ec || !fs::exists(status))
+        return ec;
+
+    if (fs::is_symlink(status)) {
+        out.isSymlink = true;
+        status = _status(path, ec);
+
+        if (ec || !fs::exists(status))
+            return ec;
+    }
+
+    out.type = fs::is_regular_file(status) ? EntryType::FILE
+               : fs::is_directory(status)  ? EntryType::DIRECTORY
+                                           : EntryType::OTHER;
+
+    // The size and the mtime are 0 if the entry is changed while reading.
+    if (out.type == EntryType::FILE) {
+        auto size = fs::file_size(path, ec);
+        out.size = ec ? 0 : static_cast<size_t>(size);
+    }
+
+    auto mtime = fs::last_write_time(path, ec);
+    out.mtime = ec ? 0 : std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+#endif // _BETTERFILE_LINUX
+
+    return std::error_code();
+}
+
+BTF_API String normalize(const String& path)
+{
+    _BETTERFILE_SCOPE("normalize");
+
+    return _pth(path).lexically_normal().generic_string();
+}
+
+BTF_API String currentPath()
+{
+    _BETTERFILE_SCOPE("currentPath");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::current_path().string();
+}
+
+BTF_API String currentPath(std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("currentPath");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    try {
+        return fs::current_path(ec).string();
+    } catch (...) {
+        ec = _currentError();
+        return String();
+    }
+}
+
+BTF_API String parentPath(const String& path)
+{
+    _BETTERFILE_SCOPE("parentPath");
+
+    return _pth(path).parent_path().string();
+}
+
+BTF_API String parentName(const String& path)
+{
+    _BETTERFILE_SCOPE("parentName");
+
+    return _pth(path).parent_path().filename().string();
+}
+
+BTF_API String filenameEx(const String& path)
+{
+    _BETTERFILE_SCOPE("filenameEx");
+
+    return _pth(path).filename().string();
+}
+
+BTF_API String filename(const String& path)
+{
+    _BETTERFILE_SCOPE("filename");
+
+    return _pth(path).filename().replace_extension().string();
+}
+
+BTF_API String extension(const String& path)
+{
+    _BETTERFILE_SCOPE("extension");
+
+    return _pth(path).extension().string();
+}
+
+BTF_API bool isExists(const String& path)
+{
+    _BETTERFILE_SCOPE("isExists");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::exists(path);
+}
+
+BTF_API bool isExists(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("isExists");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::exists(_status(path, ec));
+}
+
+BTF_API bool isFile(const String& path)
+{
+    _BETTERFILE_SCOPE("isFile");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::is_regular_file(path);
+}
+
+BTF_API bool isFile(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("isFile");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::is_regular_file(_status(path, ec));
+}
+
+BTF_API bool isDirectory(const String& path)
+{
+    _BETTERFILE_SCOPE("isDirectory");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::is_directory(path);
+}
+
+BTF_API bool isDirectory(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("isDirectory");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::is_directory(_status(path, ec));
+}
+
+BTF_API bool isSymlink(const String& path)
+{
+    _BETTERFILE_SCOPE("isSymlink");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::is_symlink(path);
+}
+
+BTF_API bool isSymlink(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("isSymlink");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::is_symlink(_status(path, ec, false));
+}
+
+BTF_API bool isEmpty(const String& path)
+{
+    _BETTERFILE_SCOPE("isEmpty");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::is_empty(path);
+}
+
+BTF_API bool isEmpty(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("isEmpty");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::is_empty(path, ec);
+}
+
+// @brief Make the paths absolute and normalized for the lexical comparison.
+// The working directory is read only if some path is relative, and once for both of them.
+BTF_API std::pair<String, String> _comparablePaths(const String& path1, const String& path2)
+{
+    _pth _path1(path1);
+    _pth _path2(path2);
+
+    if (_path1.is_relative() || _path2.is_relative()) {
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+
+        _pth cwd = fs::current_path();
+
+        if (_path1.is_relative())
+            _path1 = cwd / _path1;
+
+        if (_path2.is_relative())
+            _path2 = cwd / _path2;
+    }
+
+    return std::make_pair(_path1.lexically_normal().generic_string(), _path2.lexically_normal().generic_string());
+}
+
+// @return If the path is absolute and already normal (no empty, "." or ".." components) return true,
+// so it can be compared as is, without #normalize and #absolute.
+BTF_API bool _isNormalAbsolute(const String& path)
+{
+#ifdef _BETTERFILE_LINUX
+    if (path.empty() || path[0] != '/')
+        return false;
+
+    for (size_t i = 0; i < path.size();) {
+        size_t end = path.find('/', i + 1);
+        if (end == String::npos)
+            end = path.size();
+
+        // The component between the separator and the next one, only the trailing separator may be empty.
+        size_t size = end - i - 1;
+        if ((size == 0 && end != path.size()) || (size == 1 && path[i + 1] == '.') ||
+            (size == 2 && path[i + 1] == '.' && path[i + 2] == '.'))
+            return false;
+
+        i = end;
+    }
+
+    return true;
+#else
+    (void) path;
+    return false;
+#endif // _BETTERFILE_LINUX
+}
+
+// @return If the normalized path is the base or under the base, the base must end at a separator of the path,
+// e.g. "/a/bc" is not the sub path of "/a/b".
+BTF_API bool _isLexicalSubPath(const String& path, const String& base)
+{
+    if (path.compare(0, base.size(), base) != 0)
+        return false;
+
+    return path.size() == base.size() || base.empty() || base.back() == '/' || path[base.size()] == '/';
+}
+
+BTF_API bool isSubPath(const String& path, const String& base)
+{
+    _BETTERFILE_SCOPE("isSubPath");
+
+    if (_isNormalAbsolute(path) && _isNormalAbsolute(base))
+        return _isLexicalSubPath(path, base);
+
+    auto paths = _comparablePaths(path, base);
+
+    return _isLexicalSubPath(paths.first, paths.second);
+}
+
+BTF_API bool isRelative(const String& path)
+{
+    _BETTERFILE_SCOPE("isRelative");
+
+    return _pth(path).is_relative();
+}
+
+BTF_API bool isAbsolute(const String& path)
+{
+    _BETTERFILE_SCOPE("isAbsolute");
+
+    return _pth(path).is_absolute();
+}
+
+BTF_API String relative(const String& path, const String& base)
+{
+    _BETTERFILE_SCOPE("relative");
+
+    return fs::relative(path, base).string();
+}
+
+BTF_API String relative(const String& path, const String& base, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("relative");
+
+    try {
+        return fs::relative(path, base, ec).string();
+    } catch (...) {
+        ec = _currentError();
+        return String();
+    }
+}
+
+BTF_API String absolute(const String& path)
+{
+    _BETTERFILE_SCOPE("absolute");
+
+    return fs::absolute(path).string();
+}
+
+BTF_API String absolute(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("absolute");
+
+    try {
+        return fs::absolute(path, ec).string();
+    } catch (...) {
+        ec = _currentError();
+        return String();
+    }
+}
+
+BTF_API bool isEqualPath(const String& path1, const String& path2)
+{
+    _BETTERFILE_SCOPE("isEqualPath");
+
+    if (_isNormalAbsolute(path1) && _isNormalAbsolute(path2))
+        return path1 == path2;
+
+    auto paths = _comparablePaths(path1, path2);
+
+    return paths.first == paths.second;
+}
+
+BTF_API bool isSameFileSystemEntity(const String& path1, const String& path2)
+{
+    _BETTERFILE_SCOPE("isSameFileSystemEntity");
+    _BETTERFILE_COUNT(SYSCALLS, 2);
+
+    return fs::equivalent(path1, path2);
+}
+
+BTF_API bool isSameFileSystemEntity(const String& path1, const String& path2, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("isSameFileSystemEntity");
+    _BETTERFILE_COUNT(SYSCALLS, 2);
+
+    return fs::equivalent(path1, path2, ec);
+}
+
+#ifdef _BETTERFILE_LINUX
+
+// @brief The linux directory stream, the entries are read by getdents64 in large batches,
+// and the children are resolved relative to the directory file descriptor.
+struct _DirStream
+{
+    // The record of getdents64 (struct linux_dirent64).
+    struct Dirent64
+    {
+        unsigned long long ino;
+        long long off;
+        unsigned short reclen;
+        unsigned char type;
+        char name[1];
+    };
+
+    _Fd fd;
+    size_t pos = 0;
+    size_t len = 0;
+    alignas(Dirent64) char buffer[32 * 1024];
+};
+
+BTF_API int _dirStreamFd(void* stream)
+{
+    return static_cast<_DirStream*>(stream)->fd.get();
+}
+
+BTF_API void* _openDirStream(const String& path)
+{
+    _Fd fd(::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    if (!fd.valid())
+        throw _SystemError(_lastError(), _fmt("Failed to open the directory: \"{}\" ({})", path, std::strerror(errno)));
+
+    _DirStream* stream = new _DirStream();
+    stream->fd = std::move(fd);
+
+    return stream;
+}
+
+BTF_API void* _openDirStreamAt(void* parent, const String& name, const String& path)
+{
+    // The symlink is not followed, the walker never descends into it.
+    _Fd fd(::openat(_dirStreamFd(parent), name.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC | O_NOFOLLOW));
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    if (!fd.valid())
+        throw _SystemError(_lastError(), _fmt("Failed to open the directory: \"{}\" ({})", path, std::strerror(errno)));
+
+    _DirStream* stream = new _DirStream();
+    stream->fd = std::move(fd);
+
+    return stream;
+}
+
+BTF_API bool _readDirStream(void* stream, String& name, EntryType& type, bool& isSymlink)
+{
+    _DirStream& dir = *static_cast<_DirStream*>(stream);
+
+    while (true) {
+        if (dir.pos >= dir.len) {
+            long n = ::syscall(SYS_getdents64, dir.fd.get(), dir.buffer, sizeof(dir.buffer));
+            _BETTERFILE_COUNT(SYSCALLS, 1);
+
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            if (n < 0)
+                throw _SystemError(_lastError(), _fmt("Failed to read the directory. ({})", std::strerror(errno)));
+
+            if (n == 0)
+                return false;
+
+            dir.pos = 0;
+            dir.len = static_cast<size_t>(n);
+        }
+
+        const _DirStream::Dirent64* entry = reinterpret_cast<const _DirStream::Dirent64*>(dir.buffer + dir.pos);
+        dir.pos += entry->reclen;
+
+        const char* _name = entry->name;
+        if (_name[0] == '.' && (_name[1] == '\0' || (_name[1] == '.' && _name[2] == '\0')))
+            continue;
+
+        name.assign(_name);
+        isSymlink = false;
+        _BETTERFILE_COUNT(ENTRIES_VISITED, 1);
+
+        // Trust the d_type if the filesystem provides it, only the symlink and the unknown need stat.
+        switch (entry->type) {
+            case DT_REG:
+                type = EntryType::FILE;
+                return true;
+            case DT_DIR:
+                type = EntryType::DIRECTORY;
+                return true;
+            case DT_FIFO:
+            case DT_SOCK:
+            case DT_CHR:
+            case DT_BLK:
+                type = EntryType::OTHER;
+                return true;
+            default:
+                break;
+        }
+
+        // The entry may be removed after read.
+        struct stat st;
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+        if (::fstatat(dir.fd.get(), _name, &st, AT_SYMLINK_NOFOLLOW) != 0) {
+            type = EntryType::NONE;
+            return true;
+        }
+
+        if (S_ISLNK(st.st_mode)) {
+            isSymlink = true;
+
+            _BETTERFILE_COUNT(SYSCALLS, 1);
+            if (::fstatat(dir.fd.get(), _name, &st, 0) != 0) {
+                type = EntryType::NONE;
+                return true;
+            }
+        }
+
+        type = S_ISREG(st.st_mode) ? EntryType::FILE : S_ISDIR(st.st_mode) ? EntryType::DIRECTORY : EntryType::OTHER;
+        return true;
+    }
+}
+
+BTF_API size_t _dirStreamEntrySize(void* stream, const String& name, const String& path)
+{
+    struct stat st;
+
+    if (::fstatat(_dirStreamFd(stream), name.c_str(), &st, 0) != 0)
+        _throwIf(Errc::PATH_NOT_EXISTS, path);
+
+    return static_cast<size_t>(st.st_size);
+}
+
+BTF_API void _closeDirStream(void* stream)
+{
+    delete static_cast<_DirStream*>(stream);
+}
+
+#else
+
+struct _DirStream
+{
+    fs::directory_iterator iter;
+};
+
+BTF_API void* _openDirStream(const String& path)
+{
+    std::error_code ec;
+    fs::directory_iterator iter(path, ec);
+
+    if (ec)
+        throw _SystemError(ec, _fmt("Failed to open the directory: \"{}\" ({})", path, ec.message()));
+
+    return new _DirStream{iter};
+}
+
+BTF_API bool _readDirStream(void* stream, String& name, EntryType& type, bool& isSymlink)
+{
+    auto& iter = static_cast<_DirStream*>(stream)->iter;
+
+    if (iter == fs::directory_iterator())
+        return false;
+
+    name = iter->path().filename().string();
+    isSymlink = iter->is_symlink();
+    _BETTERFILE_COUNT(ENTRIES_VISITED, 1);
+
+    if (iter->is_regular_file())
+        type = EntryType::FILE;
+    else if (iter->is_directory())
+        type = EntryType::DIRECTORY;
+    else if (iter->exists())
+        type = EntryType::OTHER;
+    else
+        type = EntryType::NONE;
+
+    ++iter;
+
+    return true;
+}
+
+BTF_API size_t _dirStreamEntrySize(void* stream, const String& name, const String& path)
+{
+    (void) stream;
+    (void) name;
+    return fs::file_size(path);
+}
+
+BTF_API void* _openDirStreamAt(void* parent, const String& name, const String& path)
+{
+    (void) parent;
+    (void) name;
+    return _openDirStream(path);
+}
+
+BTF_API void _closeDirStream(void* stream)
+{
+    delete static_cast<_DirStream*>(stream);
+}
+
+#endif // _BETTERFILE_LINUX
+
+// @brief The #sizes, the failure of the check is reported by ec and the others are thrown.
+BTF_API size_t _sizes(const String& path, std::error_code& ec)
+{
+    ec.clear();
+
+    if (isFile(path)) {
+        return fs::file_size(path);
+    } else if (isDirectory(path)) {
+        size_t rslt = 0;
+
+        // The size is 0 if the entry is not a regular file.
+        Walker walker(path);
+        while (walker.next())
+            rslt += walker.size();
+
+        return rslt;
+    } else {
+        ec = Errc::PATH_NOT_EXISTS;
+        return 0;
+    }
+}
+
+BTF_API size_t sizes(const String& path)
+{
+    _BETTERFILE_SCOPE("sizes");
+
+    std::error_code ec;
+    size_t rslt = _sizes(path, ec);
+    _throwIf(ec, path);
+
+    return rslt;
+}
+
+BTF_API size_t sizes(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("sizes");
+
+    try {
+        return _sizes(path, ec);
+    } catch (...) {
+        ec = _currentError();
+        return 0;
+    }
+}
+
+#ifdef _BETTERFILE_LINUX
+
+// @brief The thread-safe set of (device, inode), it is sharded to reduce the lock contention.
+class _InodeSet
+{
+public:
+    // @return If the inode is inserted first time return true.
+    bool insert(dev_t dev, ino_t ino)
+    {
+        Key_ key(static_cast<unsigned long long>(dev), static_cast<unsigned long long>(ino));
+        Shard_& shard = shards_[KeyHash_()(key) % SHARD_COUNT_];
+
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        return shard.keys.insert(key).second;
+    }
+
+private:
+    static constexpr size_t SHARD_COUNT_ = 64;
+
+    using Key_ = std::pair<unsigned long long, unsigned long long>;
+
+    struct KeyHash_
+    {
+        size_t operator()(const Key_& key) const
+        {
+            return static_cast<size_t>((key.second * 0x9E3779B97F4A7C15ULL) ^ key.first);
+        }
+    };
+
+    struct Shard_
+    {
+        std::mutex mtx;
+        std::unordered_set<Key_, KeyHash_> keys;
+    };
+
+    Shard_ shards_[SHARD_COUNT_];
+};
+
+#endif // _BETTERFILE_LINUX
+
+// @brief The #diskUsage, the failure of the check is reported by ec and the others are thrown.
+BTF_API DiskUsage _diskUsage(const String& path, uint threadCount, std::map<String, DiskUsage>* dirUsages,
+                             std::error_code& ec)
+{
+    ec.clear();
+
+    // The root is followed if it is a symlink (like "du -H"), the symlinks in the tree are not.
+#ifdef _BETTERFILE_LINUX
+    struct stat rootSt;
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    if (::stat(path.c_str(), &rootSt) != 0) {
+        ec = errno == ENOENT || errno == ENOTDIR ? std::error_code(Errc::PATH_NOT_EXISTS) : _lastError();
+        return DiskUsage();
+    }
+
+    if (S_ISREG(rootSt.st_mode)) {
+        DiskUsage usage;
+        usage.files = 1;
+        usage.apparentSize = static_cast<size_t>(rootSt.st_size);
+        usage.allocatedSize = static_cast<size_t>(rootSt.st_blocks) * 512;
+        return usage;
+    } else if (!S_ISDIR(rootSt.st_mode)) {
+        ec = Errc::PATH_NOT_EXISTS;
+        return DiskUsage();
+    }
+#else
+    fs::file_status rootStatus = fs::status(path, ec);
+
+    if (ec || !fs::exists(rootStatus)) {
+        ec = Errc::PATH_NOT_EXISTS;
+        return DiskUsage();
+    }
+
+    if (fs::is_regular_file(rootStatus)) {
+        DiskUsage usage;
+        usage.files = 1;
+        usage.apparentSize = fs::file_size(path);
+        usage.allocatedSize = usage.apparentSize;
+        return usage;
+    } else if (!fs::is_directory(rootStatus)) {
+        ec = Errc::PATH_NOT_EXISTS;
+        return DiskUsage();
+    }
+#endif // _BETTERFILE_LINUX
+
+    // Each directory is a node, the usage of its direct children is filled by its task,
+    // the children nodes are always created after the parent, so the totals are summed bottom-up at last.
+    struct Node_
+    {
+        size_t parent;
+        String path;
+        DiskUsage usage;
+    };
+
+    std::deque<Node_> nodes;
+    std::mutex nodesMtx;
+    nodes.push_back(Node_{0, path, DiskUsage()});
+
+#ifdef _BETTERFILE_LINUX
+    _InodeSet inodes;
+    std::function<void(size_t)> scan;
+    _WorkStealingPool pool(threadCount);
+
+    scan = [&](size_t index) {
+        // The reference of deque element is stable when pushed back, but the access must be locked.
+        Node_* node = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(nodesMtx);
+            node = &nodes[index];
+        }
+
+        std::unique_ptr<void, void (*)(void*)> stream(_openDirStream(node->path), _closeDirStream);
+
+        DiskUsage usage;
+        String name;
+        EntryType type = EntryType::NONE;
+        bool isLink = false;
+
+        // Same as "du", the blocks of the directory itself are counted.
+        struct stat dirSt;
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+        if (::fstat(_dirStreamFd(stream.get()), &dirSt) == 0)
+            usage.allocatedSize += static_cast<size_t>(dirSt.st_blocks) * 512;
+
+        while (_readDirStream(stream.get(), name, type, isLink)) {
+            if (isLink)
+                continue;
+
+            // The directory just need the type, so the stat is only needed for others.
+            bool isDir = type == EntryType::DIRECTORY;
+            struct stat st;
+
+            if (!isDir && ::fstatat(_dirStreamFd(stream.get()), name.c_str(), &st, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+
+            if (isDir) {
+                size_t child = 0;
+                {
+                    std::lock_guard<std::mutex> lock(nodesMtx);
+                    nodes.push_back(Node_{index, pathcat(node->path, name), DiskUsage()});
+                    child = nodes.size() - 1;
+                }
+
+                ++usage.dirs;
+                pool.submit([&scan, child]() { scan(child); });
+            } else if (S_ISREG(st.st_mode)) {
+                // The file with multiple hardlinks is counted once.
+                if (st.st_nlink > 1 && !inodes.insert(st.st_dev, st.st_ino))
+                    continue;
+
+                ++usage.files;
+                usage.apparentSize += static_cast<size_t>(st.st_size);
+                usage.allocatedSize += static_cast<size_t>(st.st_blocks) * 512;
+            }
+        }
+
+        node->usage = usage;
+    };
+
+    pool.submit([&scan]() { scan(0); });
+    pool.wait();
+#else
+    // The platform has no inode, so the hardlinks are not de-duplicated.
+    for (const auto& var : fs::recursive_directory_iterator(path)) {
+        if (var.is_symlink())
+            continue;
+
+        String parentpath = var.path().parent_path().string();
+        size_t parent = nodes.size() - 1;
+        while (nodes[parent].path != parentpath)
+            --parent;
+
+        if (var.is_directory()) {
+            ++nodes[parent].usage.dirs;
+            nodes.push_back(Node_{parent, var.path().string(), DiskUsage()});
+        } else if (var.is_regular_file()) {
+            ++nodes[parent].usage.files;
+            nodes[parent].usage.apparentSize += var.file_size();
+            nodes[parent].usage.allocatedSize += var.file_size();
+        }
+    }
+
+    (void) threadCount;
+#endif // _BETTERFILE_LINUX
+
+    for (size_t i = nodes.size() - 1; i > 0; --i) {
+        DiskUsage& usage = nodes[nodes[i].parent].usage;
+        usage.files += nodes[i].usage.files;
+        usage.dirs += nodes[i].usage.dirs;
+        usage.apparentSize += nodes[i].usage.apparentSize;
+        usage.allocatedSize += nodes[i].usage.allocatedSize;
+    }
+
+    if (dirUsages) {
+        for (const auto& var : nodes)
+            (*dirUsages)[var.path] = var.usage;
+    }
+
+    return nodes[0].usage;
+}
+
+BTF_API DiskUsage diskUsage(const String& path, uint threadCount, std::map<String, DiskUsage>* dirUsages)
+{
+    _BETTERFILE_SCOPE("diskUsage");
+
+    std::error_code ec;
+    DiskUsage usage = _diskUsage(path, threadCount, dirUsages, ec);
+    _throwIf(ec, path);
+
+    return usage;
+}
+
+BTF_API DiskUsage diskUsage(const String& path, uint threadCount, std::map<String, DiskUsage>* dirUsages,
+                            std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("diskUsage");
+
+    try {
+        return _diskUsage(path, threadCount, dirUsages, ec);
+    } catch (...) {
+        ec = _currentError();
+        return DiskUsage();
+    }
+}
+
+BTF_API bool createDirectory(const String& path)
+{
+    _BETTERFILE_SCOPE("createDirectory");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::create_directory(path);
+}
+
+BTF_API bool createDirectory(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("createDirectory");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::create_directory(path, ec);
+}
+
+BTF_API bool createDirectorys(const String& path)
+{
+    _BETTERFILE_SCOPE("createDirectorys");
+
+    return fs::create_directories(path);
+}
+
+BTF_API bool createDirectorys(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("createDirectorys");
+
+    return fs::create_directories(path, ec);
+}
+
+#ifdef _BETTERFILE_LINUX
+
+// @brief Delete the children of the directory stream depth-first in the caller thread, the subdirectories are
+// opened and unlinked relative to their parents.
+// @param budget The number of entries can be still deleted, it is decreased by each entry read.
+// @param removed It is increased by the number of entries deleted.
+// @return If all the children are deleted. If the budget is run out or the tree is too deep return false,
+// the rest is left on disk.
+BTF_API bool _serialDeletes(void* stream, const String& path, size_t& budget, size_t depth, size_t& removed)
+{
+    // Each level holds an open directory, so the depth is limited.
+    constexpr size_t MAX_DEPTH = 16;
+
+    int fd = _dirStreamFd(stream);
+
+    String name;
+    EntryType type = EntryType::NONE;
+    bool isLink = false;
+
+    while (_readDirStream(stream, name, type, isLink)) {
+        if (budget == 0)
+            return false;
+        --budget;
+
+        int flags = 0;
+
+        if (type == EntryType::DIRECTORY && !isLink) {
+            if (depth >= MAX_DEPTH)
+                return false;
+
+            String subpath = pathcat(path, name);
+            std::unique_ptr<void, void (*)(void*)> sub(_openDirStreamAt(stream, name, subpath), _closeDirStream);
+
+            if (!_serialDeletes(sub.get(), subpath, budget, depth + 1, removed))
+                return false;
+
+            flags = AT_REMOVEDIR;
+        }
+
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+        if (::unlinkat(fd, name.c_str(), flags) == 0)
+            ++removed;
+        else if (errno != ENOENT)
+            throw _SystemError(_lastError(),
+                               _fmt("Failed to delete the {}: \"{}\" ({})", flags == 0 ? "file" : "directory",
+                                    pathcat(path, name), std::strerror(errno)));
+    }
+
+    return true;
+}
+
+#endif // _BETTERFILE_LINUX
+
+// @return If the path not exists, return 0.
+// @note Even if the path not exists not throw exception.
+BTF_API size_t deletes(const String& path, uint threadCount)
+{
+    _BETTERFILE_SCOPE("deletes");
+
+#ifdef _BETTERFILE_LINUX
+    // The single file is unlinked directly, without the cost of the workers.
+    struct stat st;
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+    if (::lstat(path.c_str(), &st) != 0) {
+        if (errno == ENOENT)
+            return 0;
+        throw _SystemError(_lastError(), _fmt("Failed to stat the path: \"{}\" ({})", path, std::strerror(errno)));
+    }
+
+    if (S_ISDIR(st.st_mode)) {
+        // The small tree is deleted serially, the workers are only worth for the large one,
+        // they delete the rest which the serial walk stops at.
+        constexpr size_t SERIAL_LIMIT = 1024;
+
+        size_t budget = SERIAL_LIMIT;
+        size_t removed = 0;
+        bool isDone = false;
+        {
+            std::unique_ptr<void, void (*)(void*)> stream(_openDirStream(path), _closeDirStream);
+            isDone = _serialDeletes(stream.get(), path, budget, 0, removed);
+        }
+
+        if (!isDone)
+            return removed + parallelDeletes(path, threadCount);
+
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+        if (::rmdir(path.c_str()) != 0) {
+            if (errno == ENOENT)
+                return removed;
+            throw _SystemError(_lastError(),
+                               _fmt("Failed to delete the directory: \"{}\" ({})", path, std::strerror(errno)));
+        }
+
+        return removed + 1;
+    }
+
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+    if (::unlink(path.c_str()) != 0) {
+        if (errno == ENOENT)
+            return 0;
+        throw _SystemError(_lastError(), _fmt("Failed to delete the file: \"{}\" ({})", path, std::strerror(errno)));
+    }
+
+    return 1;
+#else
+    (void) threadCount;
+    return fs::remove_all(path);
+#endif // _BETTERFILE_LINUX
+}
+
+BTF_API size_t deletes(const String& path, uint threadCount, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("deletes");
+
+    // The path which not exists is not a failure, so nothing is thrown in that case.
+    try {
+        ec.clear();
+        return deletes(path, threadCount);
+    } catch (...) {
+        ec = _currentError();
+        return 0;
+    }
+}
+
+BTF_API size_t deletes(const String& path, std::error_code& ec) noexcept
+{
+    return deletes(path, 0, ec);
+}
+
+BTF_API size_t parallelDeletes(const String& path, uint threadCount, const std::function<void(size_t)>& onProgress)
+{
+    _BETTERFILE_SCOPE("parallelDeletes");
+
+#ifdef _BETTERFILE_LINUX
+    struct stat st;
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+    if (::lstat(path.c_str(), &st) != 0) {
+        if (errno == ENOENT)
+            return 0;
+        throw _SystemError(_lastError(), _fmt("Failed to stat the path: \"{}\" ({})", path, std::strerror(errno)));
+    }
+
+    if (!S_ISDIR(st.st_mode))
+        return deletes(path);
+
+    // Each directory is a node, it is deleted by the last of its scan and its subdirectories finished.
+    struct Node_
+    {
+        Node_(size_t parent, String path) : parent(parent), path(std::move(path)) {}
+
+        size_t parent;
+        String path;
+        std::atomic<size_t> pending{1};     // The scan and the subdirectories not deleted.
+    };
+
+    constexpr size_t NOF = size_t(-1);
+    constexpr size_t PROGRESS_STEP = 4096;
+
+    std::deque<Node_> nodes;
+    std::mutex nodesMtx;
+    std::atomic<size_t> removed{0};
+    std::mutex progressMtx;
+    std::atomic<size_t> reported{0};    // It is only stored under progressMtx, but loaded without it.
+    std::function<void(size_t)> scan;
+    _WorkStealingPool pool(threadCount);
+
+    nodes.emplace_back(NOF, path);
+
+    auto count = [&](size_t n) {
+        size_t total = removed.fetch_add(n, std::memory_order_relaxed) + n;
+
+        if (!onProgress || total < reported.load(std::memory_order_relaxed) + PROGRESS_STEP)
+            return;
+
+        std::unique_lock<std::mutex> lock(progressMtx, std::try_to_lock);
+        if (lock.owns_lock() && total >= reported.load(std::memory_order_relaxed) + PROGRESS_STEP) {
+            reported.store(total, std::memory_order_relaxed);
+            onProgress(total);
+        }
+    };
+
+    // Delete the directory if all its children are deleted, and propagate to its parent.
+    auto finish = [&](size_t index) {
+        while (index != NOF) {
+            Node_* node = nullptr;
+            {
+                std::lock_guard<std::mutex> lock(nodesMtx);
+                node = &nodes[index];
+            }
+
+            if (node->pending.fetch_sub(1, std::memory_order_acq_rel) != 1)
+                return;
+
+            _BETTERFILE_COUNT(SYSCALLS, 1);
+            if (::rmdir(node->path.c_str()) != 0) {
+                if (errno != ENOENT)
+                    throw _SystemError(_lastError(),
+                                       _fmt("Failed to delete the directory: \"{}\" ({})", node->path,
+                                            std::strerror(errno)));
+            } else {
+                count(1);
+            }
+
+            index = node->parent;
+        }
+    };
+
+    scan = [&](size_t index) {
+        // The reference of deque element is stable when pushed back, but the access must be locked.
+        Node_* node = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(nodesMtx);
+            node = &nodes[index];
+        }
+
+        {
+            std::unique_ptr<void, void (*)(void*)> stream(_openDirStream(node->path), _closeDirStream);
+            int fd = _dirStreamFd(stream.get());
+
+            String name;
+            EntryType type = EntryType::NONE;
+            bool isLink = false;
+            size_t unlinked = 0;
+
+            while (_readDirStream(stream.get(), name, type, isLink)) {
+                if (type == EntryType::DIRECTORY && !isLink) {
+                    size_t child = 0;
+                    {
+                        std::lock_guard<std::mutex> lock(nodesMtx);
+                        nodes.emplace_back(index, pathcat(node->path, name));
+                        child = nodes.size() - 1;
+                    }
+
+                    node->pending.fetch_add(1, std::memory_order_relaxed);
+                    pool.submit([&scan, child]() { scan(child); });
+                } else {
+                    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+                    if (::unlinkat(fd, name.c_str(), 0) == 0)
+                        ++unlinked;
+                    else if (errno != ENOENT)
+                        throw _SystemError(_lastError(),
+                                           _fmt("Failed to delete the file: \"{}\" ({})", pathcat(node->path, name),
+                                                std::strerror(errno)));
+                }
+            }
+
+            count(unlinked);
+        }
+
+        finish(index);
+    };
+
+    pool.submit([&scan]() { scan(0); });
+    pool.wait();
+
+    size_t total = removed.load();
+#else
+    (void) threadCount;
+    size_t total = deletes(path);
+#endif // _BETTERFILE_LINUX
+
+    if (onProgress)
+        onProgress(total);
+
+    return total;
+}
+
+BTF_API size_t parallelDeletes(const String& path, uint threadCount, const std::function<void(size_t)>& onProgress,
+                               std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("parallelDeletes");
+
+    try {
+        ec.clear();
+        return parallelDeletes(path, threadCount, onProgress);
+    } catch (...) {
+        ec = _currentError();
+        return 0;
+    }
+}
+
+#ifdef _BETTERFILE_LINUX
+
+// @brief Copy the rest data from the current offset of in to the current offset of out.
+// @return The strategy which finished the copy, if all strategies failed return CopyStrategy::NONE.
+BTF_API CopyStrategy _copyFdData(int in, int out, size_t size)
+{
+    // The empty file (or the pseudo file which reports size 0) just use the buffered loop.
+    if (size > 0) {
+        // Reflink, the data blocks are shared until written.
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+        if (::ioctl(out, FICLONE, in) == 0)
+            return CopyStrategy::REFLINK;
+
+        // The copy_file_range and sendfile return 0 at end of file, and the partial copy of a strategy
+        // is continued by next strategy from the current offsets.
+        size_t copied = 0;
+        while (true) {
+            ssize_t n = ::copy_file_range(in, nullptr, out, nullptr, size, 0);
+            _BETTERFILE_COUNT(SYSCALLS, 1);
+
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            if (n == 0 && copied > 0)
+                return CopyStrategy::COPY_FILE_RANGE;
+
+            if (n <= 0)
+                break;
+
+            _BETTERFILE_COUNT(BYTES_READ, n);
+            _BETTERFILE_COUNT(BYTES_WRITTEN, n);
+            copied += static_cast<size_t>(n);
+        }
+
+        copied = 0;
+        while (true) {
+            ssize_t n = ::sendfile(out, in, nullptr, size);
+            _BETTERFILE_COUNT(SYSCALLS, 1);
+
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            if (n == 0 && copied > 0)
+                return CopyStrategy::SENDFILE;
+
+            if (n <= 0)
+                break;
+
+            _BETTERFILE_COUNT(BYTES_READ, n);
+            _BETTERFILE_COUNT(BYTES_WRITTEN, n);
+            copied += static_cast<size_t>(n);
+        }
+    }
+
+    Vec<char> buffer(_LARGE_BUFFER_SIZE);
+    while (true) {
+        ssize_t n = ::read(in, buffer.data(), buffer.size());
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0)
+            return CopyStrategy::NONE;
+
+        if (n == 0)
+            return CopyStrategy::BUFFERED;
+
+        _BETTERFILE_COUNT(BYTES_READ, n);
+
+        if (!_writeAll(out, buffer.data(), static_cast<size_t>(n)))
+            return CopyStrategy::NONE;
+    }
+}
+
+#endif // _BETTERFILE_LINUX
+
+// @brief The #copyFileData, the failure to open the source is reported by ec and the others are thrown.
+BTF_API CopyStrategy _copyFileData(const String& src, const String& dst, std::error_code& ec)
+{
+    ec.clear();
+
+#ifdef _BETTERFILE_LINUX
+    // The open of source, the fstat, the stat and the open of destination.
+    _BETTERFILE_COUNT(SYSCALLS, 4);
+
+    _Fd in(::open(src.c_str(), O_RDONLY | O_CLOEXEC));
+
+    if (!in.valid()) {
+        ec = _lastError();
+        return CopyStrategy::NONE;
+    }
+
+    struct stat st;
+    if (::fstat(in.get(), &st) != 0)
+        throw _SystemError(_lastError(), _fmt("Failed to stat the file: \"{}\" ({})", src, std::strerror(errno)));
+
+    // The destination is truncated when opened, so it must not be the source itself (or a hardlink of it).
+    struct stat dstSt;
+    if (::stat(dst.c_str(), &dstSt) == 0 && dstSt.st_dev == st.st_dev && dstSt.st_ino == st.st_ino)
+        throw _SystemError(std::make_error_code(std::errc::file_exists),
+                           _fmt("Failed to copy the file to itself. \"{}\" -> \"{}\"", src, dst));
+
+    _Fd out(::open(dst.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777));
+
+    if (!out.valid())
+        throw _SystemError(_lastError(), _fmt("Failed to open the file: \"{}\" ({})", dst, std::strerror(errno)));
+
+    CopyStrategy strategy = _copyFdData(in.get(), out.get(), static_cast<size_t>(st.st_size));
+
+    if (strategy == CopyStrategy::NONE)
+        throw _SystemError(_lastError(),
+                           _fmt("Failed to copy the file. \"{}\" -> \"{}\" ({})", src, dst, std::strerror(errno)));
+
+    return strategy;
+#else
+    if (!isFile(src)) {
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+        return CopyStrategy::NONE;
+    }
+
+    fs::copy_file(src, dst, fs::copy_options::overwrite_existing);
+    return CopyStrategy::FILESYSTEM;
+#endif // _BETTERFILE_LINUX
+}
+
+BTF_API CopyStrategy copyFileData(const String& src, const String& dst)
+{
+    _BETTERFILE_SCOPE("copyFileData");
+
+    std::error_code ec;
+    CopyStrategy strategy = _copyFileData(src, dst, ec);
+
+    if (ec)
+        throw _SystemError(ec, _fmt("Failed to open the file: \"{}\" ({})", src, ec.message()));
+
+    return strategy;
+}
+
+BTF_API CopyStrategy copyFileData(const String& src, const String& dst, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("copyFileData");
+
+    try {
+        return _copyFileData(src, dst, ec);
+    } catch (...) {
+        ec = _currentError();
+        return CopyStrategy::NONE;
+    }
+}
+
+// @brief The #writeFile, the failure to open the file is reported by ec and the others are thrown.
+BTF_API void _writeFile(const String& path, const char* data, size_t size, std::error_code& ec)
+{
+    ec.clear();
+
+#ifdef _BETTERFILE_LINUX
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+    _Fd fd(::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666));
+
+    if (!fd.valid()) {
+        ec = _lastError();
+        return;
+    }
+
+    if (!_writeAll(fd.get(), data, size))
+        throw _SystemError(_lastError(), _fmt("Failed to write the file: \"{}\" ({})", path, std::strerror(errno)));
+#else
+    std::ofstream ofs(path.data(), std::ios_base::binary);
+
+    if (!ofs.is_open()) {
+        ec = std::make_error_code(std::errc::io_error);
+        return;
+    }
+
+    ofs.write(data, size);
+#endif // _BETTERFILE_LINUX
+}
+
+BTF_API void writeFile(const String& path, const char* data, size_t size)
+{
+    _BETTERFILE_SCOPE("writeFile");
+
+    std::error_code ec;
+    _writeFile(path, data, size, ec);
+
+    if (ec)
+        throw _SystemError(ec, _fmt("Failed to open the file: \"{}\" ({})", path, ec.message()));
+}
+
+BTF_API void writeFile(const String& path, const char* data, size_t size, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("writeFile");
+
+    try {
+        _writeFile(path, data, size, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+// @brief The #hashFile, the failure to open the file is reported by ec and the others are thrown.
+BTF_API uint64_t _hashFile(const String& path, std::error_code& ec)
+{
+    ec.clear();
+
+#ifdef _BETTERFILE_LINUX
+    _Fd fd(::open(path.c_str(), O_RDONLY | O_CLOEXEC));
+
+    if (!fd.valid()) {
+        ec = _lastError();
+        return 0;
+    }
+
+    _Xxh3 state;
+    String buffer(_LARGE_BUFFER_SIZE, '\0');
+
+    ::posix_fadvise(fd.get(), 0, 0, POSIX_FADV_SEQUENTIAL);
+    _BETTERFILE_COUNT(SYSCALLS, 2);
+
+    while (true) {
+        ssize_t n = ::read(fd.get(), &buffer[0], buffer.size());
+        _BETTERFILE_COUNT(SYSCALLS, 1);
+
+        if (n < 0 && errno == EINTR)
+            continue;
+
+        if (n < 0)
+            throw _SystemError(_lastError(), _fmt("Failed to read the file: \"{}\" ({})", path, std::strerror(errno)));
+
+        if (n == 0)
+            break;
+
+        _BETTERFILE_COUNT(BYTES_READ, n);
+
+        state.update(buffer.data(), static_cast<size_t>(n));
+    }
+#else
+    std::ifstream ifs(path, std::ios_base::binary);
+
+    if (!ifs.is_open()) {
+        ec = std::make_error_code(std::errc::io_error);
+        return 0;
+    }
+
+    _Xxh3 state;
+    String buffer(_LARGE_BUFFER_SIZE, '\0');
+
+    while (ifs.read(&buffer[0], buffer.size()) || ifs.gcount() > 0)
+        state.update(buffer.data(), static_cast<size_t>(ifs.gcount()));
+#endif // _BETTERFILE_LINUX
+
+    return state.digest();
+}
+
+BTF_API uint64_t hashFile(const String& path)
+{
+    _BETTERFILE_SCOPE("hashFile");
+
+    std::error_code ec;
+    uint64_t hash = _hashFile(path, ec);
+
+    if (ec)
+        throw _SystemError(ec, _fmt("Failed to open the file: \"{}\" ({})", path, ec.message()));
+
+    return hash;
+}
+
+BTF_API uint64_t hashFile(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("hashFile");
+
+    try {
+        return _hashFile(path, ec);
+    } catch (...) {
+        ec = _currentError();
+        return 0;
+    }
+}
+
+// @brief The #digest, the failure of the check is reported by ec and the others are thrown.
+BTF_API uint64_t _digest(const String& path, uint threadCount, std::map<String, uint64_t>* dirDigests,
+                         std::error_code& ec)
+{
+    ec.clear();
+
+    if (isFile(path))
+        return hashFile(path);
+
+    if (!isDirectory(path)) {
+        ec = Errc::PATH_NOT_EXISTS;
+        return 0;
+    }
+
+    // Each directory is a node, its children are filled by its task and the files are hashed by separate tasks,
+    // the children nodes are always created after the parent, so the digests are combined bottom-up at last.
+    struct Child_
+    {
+        String name;
+        bool isDir;
+        size_t node;        // The index of the node if it is directory.
+        uint64_t hash;
+    };
+
+    struct Node_
+    {
+        String path;
+        Vec<Child_> children;
+        uint64_t hash;
+    };
+
+    std::deque<Node_> nodes;
+    std::mutex nodesMtx;
+    std::function<void(size_t)> scan;
+    _WorkStealingPool pool(threadCount);
+
+    nodes.push_back(Node_{path, Vec<Child_>(), 0});
+
+    scan = [&](size_t index) {
+        // The reference of deque element is stable when pushed back, but the access must be locked.
+        Node_* node = nullptr;
+        {
+            std::lock_guard<std::mutex> lock(nodesMtx);
+            node = &nodes[index];
+        }
+
+        Walker walker(node->path, false);
+        Strings files;
+
+        for (const auto& var : walker) {
+            if (var.isDirectory() && !var.isSymlink()) {
+                size_t child = 0;
+                {
+                    std::lock_guard<std::mutex> lock(nodesMtx);
+                    nodes.push_back(Node_{var.path(), Vec<Child_>(), 0});
+                    child = nodes.size() - 1;
+                }
+
+                node->children.push_back(Child_{var.name(), true, child, 0});
+                pool.submit([&scan, child]() { scan(child); });
+            } else if (var.isDirectory()) {
+                // The symlink to directory is not descended (it may refer to its ancestor), it is a leaf
+                // whose hash is of the target path.
+                String target = symlinkTarget(var.path());
+                node->children.push_back(Child_{var.name(), false, 0, hash64(target.data(), target.size())});
+            } else if (var.isFile()) {
+                files.push_back(var.name());
+            }
+        }
+
+        // The children are not resized after here, so the files can be hashed in place.
+        size_t first = node->children.size();
+        node->children.reserve(first + files.size());
+
+        for (auto& var : files)
+            node->children.push_back(Child_{std::move(var), false, 0, 0});
+
+        for (size_t i = first; i < node->children.size(); ++i) {
+            Child_* child = &node->children[i];
+            String filepath = pathcat(node->path, child->name);
+            pool.submit([child, filepath]() { child->hash = hashFile(filepath); });
+        }
+    };
+
+    pool.submit([&scan]() { scan(0); });
+    pool.wait();
+
+    Vec<_MerkleEntry> entries;
+
+    for (size_t i = nodes.size(); i > 0; --i) {
+        Node_& node = nodes[i - 1];
+        entries.clear();
+
+        for (const auto& var : node.children)
+            entries.push_back(_MerkleEntry{&var.name, var.isDir, var.isDir ? nodes[var.node].hash : var.hash});
+
+        node.hash = _merkleHash(entries);
+    }
+
+    if (dirDigests) {
+        for (const auto& var : nodes)
+            (*dirDigests)[var.path] = var.hash;
+    }
+
+    return nodes[0].hash;
+}
+
+BTF_API uint64_t digest(const String& path, uint threadCount, std::map<String, uint64_t>* dirDigests)
+{
+    _BETTERFILE_SCOPE("digest");
+
+    std::error_code ec;
+    uint64_t hash = _digest(path, threadCount, dirDigests, ec);
+    _throwIf(ec, path);
+
+    return hash;
+}
+
+BTF_API uint64_t digest(const String& path, uint threadCount, std::map<String, uint64_t>* dirDigests,
+                        std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("digest");
+
+    try {
+        return _digest(path, threadCount, dirDigests, ec);
+    } catch (...) {
+        ec = _currentError();
+        return 0;
+    }
+}
+
+// The max number of files and the max total size of the files of a group of #_commitWrites.
+constexpr size_t _COMMIT_GROUP_FILES = 4096;
+constexpr size_t _COMMIT_GROUP_BYTES = 256 * 1024 * 1024;
+
+// @return The path without the trailing separators, the root separator is kept.
+inline String _trimTrailingSeparators(String path)
+{
+    while (path.size() > 1 && (path.back() == WIN_PATH_SEPARATOR || path.back() == LINUX_PATH_SEPARATOR))
+        path.pop_back();
+
+    return path;
+}
+
+// @return The unique temporary path in the same directory of the path (the trailing separators are ignored).
+BTF_API String _tempSibling(const String& path)
+{
+    static std::atomic<size_t> counter{0};
+
+#ifdef _BETTERFILE_LINUX
+    size_t id = static_cast<size_t>(::getpid());
+#else
+    size_t id = static_cast<size_t>(std::chrono::steady_clock::now().time_since_epoch().count());
+#endif // _BETTERFILE_LINUX
+
+    return pathcat(parentPath(_trimTrailingSeparators(path)),
+                   _fmt(".btf-{}-{}.tmp", id, counter.fetch_add(1, std::memory_order_relaxed)));
+}
+
+// @brief A single thread which runs the tasks in order, it is started by the first task.
+// The tasks queued are all finished before it is destroyed.
+class _BackgroundWorker
+{
+public:
+    using Task = std::packaged_task<size_t()>;
+
+    _BackgroundWorker() = default;
+
+    _BackgroundWorker(const _BackgroundWorker&) = delete;
+
+    _BackgroundWorker& operator=(const _BackgroundWorker&) = delete;
+
+    ~_BackgroundWorker()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            stop_ = true;
+        }
+        cv_.notify_all();
+
+        if (thread_.joinable())
+            thread_.join();
+    }
+
+    void submit(Task task)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mtx_);
+            tasks_.push_back(std::move(task));
+
+            if (!thread_.joinable())
+                thread_ = std::thread(&_BackgroundWorker::run_, this);
+        }
+        cv_.notify_one();
+    }
+
+private:
+    void run_()
+    {
+        while (true) {
+            Task task;
+            {
+                std::unique_lock<std::mutex> lock(mtx_);
+                cv_.wait(lock, [this]() { return stop_ || !tasks_.empty(); });
+
+                // The rest tasks are drained even if stopped.
+                if (tasks_.empty())
+                    return;
+
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+
+            // The exception is stored to the future of the task.
+            task();
+        }
+    }
+
+    std::mutex mtx_;
+    std::condition_variable cv_;
+    std::deque<Task> tasks_;
+    std::thread thread_;
+    bool stop_ = false;
+};
+
+// @return The worker of #deletesInBackground, it is drained at the exit of process.
+// @note It is created after the instrumentation registry (registered by the caller first), so it is destroyed before
+// the registry, and the deletes still running at exit are measured safely.
+BTF_API _BackgroundWorker& _backgroundDeleter()
+{
+    static _BackgroundWorker worker;
+    return worker;
+}
+
+BTF_API std::future<size_t> deletesInBackground(const String& path, uint threadCount)
+{
+    _BETTERFILE_SCOPE("deletesInBackground");
+
+    std::packaged_task<size_t()> task;
+
+    if (!isExists(path) && !isSymlink(path)) {
+        task = std::packaged_task<size_t()>([]() { return size_t(0); });
+        task();
+        return task.get_future();
+    }
+
+    // The delete runs later, so the path is resolved against the current directory now.
+    String target = _trimTrailingSeparators(absolute(path));
+    String aside = _tempSibling(target);
+    std::error_code ec;
+
+    fs::rename(target, aside, ec);
+
+    if (ec)
+        throw _SystemError(ec, _fmt("Failed to rename the path: \"{}\" ({})", path, ec.message()));
+
+    task = std::packaged_task<size_t()>([aside, threadCount]() { return parallelDeletes(aside, threadCount); });
+    std::future<size_t> future = task.get_future();
+    _backgroundDeleter().submit(std::move(task));
+
+    return future;
+}
+
+#ifdef _BETTERFILE_LINUX
+
+// @brief Write the data of the WRITE or COPY task to the temporary file.
+// If the target exists, its mode and owner (if permitted) are applied to the temporary file,
+// else the temporary file has the mode of the file created by a default write.
+// @param bytes The size written is added to it.
+// @return The file descriptor of the temporary file.
+BTF_API _Fd _writeTemp(const _IoTask& task, const String& target, const String& temp, size_t& bytes)
+{
+    _Fd in;
+    uint mode = task.mode;
+    size_t size = task.size;
+
+    if (task.kind == _IoTask::COPY) {
+        // The open and the fstat of source.
+        _BETTERFILE_COUNT(SYSCALLS, 2);
+
+        struct stat st;
+        in.reset(::open(task.path.c_str(), O_RDONLY | O_CLOEXEC));
+
+        if (!in.valid() || ::fstat(in.get(), &st) != 0)
+            throw _SystemError(_lastError(),
+                               _fmt("Failed to open the file: \"{}\" ({})", task.path, std::strerror(errno)));
+
+        mode = st.st_mode & 07777;
+        size = static_cast<size_t>(st.st_size);
+    }
+
+    // The open of temporary file and the stat of target.
+    _BETTERFILE_COUNT(SYSCALLS, 2);
+
+    _Fd out(::open(temp.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, mode));
+
+    if (!out.valid())
+        throw _SystemError(_lastError(), _fmt("Failed to open the file: \"{}\" ({})", temp, std::strerror(errno)));
+
+    struct stat st;
+    if (::stat(target.c_str(), &st) == 0) {
+        // The owner is changed first, the fchown may clear the set-user-ID and set-group-ID bits.
+        // Only the root can give the file to another user, so the EPERM just keeps the owner of the caller.
+        _BETTERFILE_COUNT(SYSCALLS, 2);
+
+        if ((::fchown(out.get(), st.st_uid, st.st_gid) != 0 && errno != EPERM) ||
+            ::fchmod(out.get(), st.st_mode & 07777) != 0)
+            throw _SystemError(_lastError(),
+                               _fmt("Failed to set the mode of the file: \"{}\" ({})", temp, std::strerror(errno)));
+    }
+
+    if (task.kind == _IoTask::COPY) {
+        if (_copyFdData(in.get(), out.get(), size) == CopyStrategy::NONE)
+            throw _SystemError(_lastError(), _fmt("Failed to copy the file. \"{}\" -> \"{}\" ({})", task.path, temp,
+                                                  std::strerror(errno)));
+    } else if (!_writeAll(out.get(), task.data, task.size)) {
+        throw _SystemError(_lastError(), _fmt("Failed to write the file: \"{}\" ({})", temp, std::strerror(errno)));
+    }
+
+    bytes += size;
+    return out;
+}
+
+#else
+
+// @brief Write the data of the WRITE or COPY task to the temporary file.
+// If the target exists, its permissions are applied to the temporary file.
+// @param bytes The size written is added to it.
+BTF_API void _writeTemp(const _IoTask& task, const String& target, const String& temp, size_t& bytes)
+{
+    if (task.kind == _IoTask::COPY) {
+        copyFileData(task.path, temp);
+        bytes += static_cast<size_t>(fs::file_size(temp));
+    } else {
+        writeFile(temp, task.data, task.size);
+        bytes += task.size;
+    }
+
+    std::error_code ec;
+    fs::file_status status = fs::status(target, ec);
+
+    if (!ec && fs::exists(status))
+        fs::permissions(temp, status.permissions());
+}
+
+#endif // _BETTERFILE_LINUX
+
+// @brief Write the files of the WRITE and COPY tasks (to the path and the dstPath) by WriteMode::ATOMIC or
+// WriteMode::DURABLE. The files are written to temporary siblings and renamed into place by groups, if durable,
+// the data of each group is flushed by one syncfs (per filesystem) before the renames, and each of the dirs is
+// flushed once by fsync after all renames, rather than a fsync per file.
+// @param dirs The directories whose entries are changed (the parents of the files and the created directories).
+// @note The durability is only supported on linux, else the mode DURABLE is same as ATOMIC.
+BTF_API void _commitWrites(const Vec<_IoTask>& tasks, const Strings& dirs, bool isDurable)
+{
+#ifndef _BETTERFILE_LINUX
+    (void) isDurable;
+#endif // !_BETTERFILE_LINUX
+
+    Strings temps;
+
+    // Remove the temporary files not renamed yet when failed.
+    auto cleanup = [&temps](size_t from) {
+        for (size_t i = from; i < temps.size(); ++i) {
+            std::error_code ec;
+            fs::remove(temps[i], ec);
+        }
+    };
+
+    for (size_t begin = 0; begin < tasks.size();) {
+        size_t end = begin;
+        size_t bytes = 0;
+        temps.clear();
+
+#ifdef _BETTERFILE_LINUX
+        // The first temporary file of each filesystem, the filesystem is flushed by it.
+        Vec<std::pair<dev_t, _Fd>> devices;
+#endif // _BETTERFILE_LINUX
+
+        try {
+            while (end < tasks.size() && end - begin < _COMMIT_GROUP_FILES && bytes < _COMMIT_GROUP_BYTES) {
+                const _IoTask& task = tasks[end++];
+                const String& target = task.kind == _IoTask::COPY ? task.dstPath : task.path;
+
+                temps.push_back(_tempSibling(target));
+
+#ifdef _BETTERFILE_LINUX
+                _Fd fd = _writeTemp(task, target, temps.back(), bytes);
+
+                if (isDurable) {
+                    struct stat st;
+                    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+                    if (::fstat(fd.get(), &st) != 0)
+                        throw _SystemError(_lastError(),
+                                           _fmt("Failed to stat the file: \"{}\" ({})", temps.back(),
+                                                std::strerror(errno)));
+
+                    bool isKnown = false;
+                    for (const auto& var : devices)
+                        isKnown = isKnown || var.first == st.st_dev;
+
+                    if (!isKnown)
+                        devices.emplace_back(st.st_dev, std::move(fd));
+                }
+#else
+                _writeTemp(task, target, temps.back(), bytes);
+#endif // _BETTERFILE_LINUX
+            }
+
+#ifdef _BETTERFILE_LINUX
+            // The data must be on disk before the renames, else a crash may leave the renamed file empty.
+            for (const auto& var : devices) {
+                _BETTERFILE_COUNT(SYSCALLS, 1);
+
+                if (::syncfs(var.second.get()) != 0)
+                    throw _SystemError(_lastError(), _fmt("Failed to sync the filesystem ({})", std::strerror(errno)));
+            }
+#endif // _BETTERFILE_LINUX
+        } catch (...) {
+            cleanup(0);
+            throw;
+        }
+
+        for (size_t i = begin; i < end; ++i) {
+            const _IoTask& task = tasks[i];
+            const String& target = task.kind == _IoTask::COPY ? task.dstPath : task.path;
+            std::error_code ec;
+
+            fs::rename(temps[i - begin], target, ec);
+
+            if (ec) {
+                cleanup(i - begin);
+                throw _SystemError(ec, _fmt("Failed to rename the file: \"{}\" ({})", target, ec.message()));
+            }
+        }
+
+        begin = end;
+    }
+
+#ifdef _BETTERFILE_LINUX
+    if (isDurable) {
+        for (const auto& var : dirs) {
+            _Fd fd(::open(var.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC));
+
+            if (!fd.valid() || ::fsync(fd.get()) != 0)
+                throw _SystemError(_lastError(),
+                                   _fmt("Failed to sync the directory: \"{}\" ({})", var, std::strerror(errno)));
+        }
+    }
+#else
+    (void) dirs;
+#endif // _BETTERFILE_LINUX
+}
+
+// @brief Create the parent directory of the destination if it not exists.
+BTF_API void _createParentOf(const Entry& to)
+{
+    // The parent exists if the destination exists.
+    if (to.isExists() || to.isSymlink())
+        return;
+
+    String parent = parentPath(to.path());
+
+    if (!parent.empty() && !Entry(parent).isDirectory())
+        createDirectorys(parent);
+}
+
+// @brief Prepare the destination of a regular file copy by the overwrite and skip rules of #copy.
+// @param to The metadata of dst read by #_statEntry, the path is passed separately so the walks pass their
+// reused buffer (e.g. #PathBuilder::path) without copying it.
+// @param isParentExists If true, the parent of destination is known to exist (e.g. it is created by the walk).
+// @return If the file should be skipped return false.
+BTF_API bool _prepareCopyFile(const String& src, const String& dst, const _EntryStat& to, bool isOverwrite,
+                              bool isParentExists = false)
+{
+    bool isExists = to.type != EntryType::NONE;
+
+    // If the destination path exists same name file or directory and specified not overwrite, do nothing.
+    if (!isOverwrite && isExists)
+        return false;
+
+    // If the destination path has a same name directory (not file), throw exception.
+    if (to.type == EntryType::DIRECTORY)
+        _throwIf(Errc::DESTINATION_IS_DIRECTORY, src, dst);
+
+    // Create the parent directory of the destination path first if not exists.
+    if (!isParentExists)
+        _createParentOf(Entry(dst, to.type, to.isSymlink));
+
+    // If the destination path is a file (or a symlink), delete it first.
+    if (isExists || to.isSymlink)
+        deletes(dst);
+
+    return true;
+}
+
+BTF_API bool _prepareCopyFile(const String& src, const Entry& to, bool isOverwrite, bool isParentExists = false)
+{
+    _EntryStat stat;
+    stat.type = to.type();
+    stat.isSymlink = to.isSymlink();
+
+    return _prepareCopyFile(src, to.path(), stat, isOverwrite, isParentExists);
+}
+
+// @brief Copy a regular file with the overwrite and skip rules of #copy.
+// @return The strategy used, if skipped return CopyStrategy::NONE.
+BTF_API CopyStrategy _copyFile(const String& src, const String& dst, const _EntryStat& to, bool isOverwrite,
+                               bool isParentExists = false)
+{
+    if (!_prepareCopyFile(src, dst, to, isOverwrite, isParentExists))
+        return CopyStrategy::NONE;
+
+    return copyFileData(src, dst);
+}
+
+BTF_API CopyStrategy _copyFile(const String& src, const Entry& to, bool isOverwrite, bool isParentExists = false)
+{
+    if (!_prepareCopyFile(src, to, isOverwrite, isParentExists))
+        return CopyStrategy::NONE;
+
+    return copyFileData(src, to.path());
+}
+
+// @brief The #copyFile, the failure of the check is reported by ec and the others are thrown.
+BTF_API CopyStrategy _copyFileChecked(const Entry& from, const String& dst, bool isOverwrite, std::error_code& ec)
+{
+    ec.clear();
+
+    // If the source path equals the destination path, do nothing.
+    if (isEqualPath(from.path(), dst))
+        return CopyStrategy::NONE;
+
+    if (from.error()) {
+        ec = from.error();
+        return CopyStrategy::NONE;
+    }
+
+    if (!from.isFile()) {
+        ec = Errc::SOURCE_NOT_FILE;
+        return CopyStrategy::NONE;
+    }
+
+    return _copyFile(from.path(), Entry(dst), isOverwrite);
+}
+
+BTF_API CopyStrategy copyFile(const String& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("copyFile");
+
+    std::error_code ec;
+    CopyStrategy strategy = _copyFileChecked(Entry(src), dst, isOverwrite, ec);
+    _throwIf(ec, src, dst);
+
+    return strategy;
+}
+
+BTF_API CopyStrategy copyFile(const Entry& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("copyFile");
+
+    std::error_code ec;
+    CopyStrategy strategy = _copyFileChecked(src, dst, isOverwrite, ec);
+    _throwIf(ec, src.path(), dst);
+
+    return strategy;
+}
+
+BTF_API CopyStrategy copyFile(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("copyFile");
+
+    try {
+        return _copyFileChecked(Entry(src), dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+        return CopyStrategy::NONE;
+    }
+}
+
+BTF_API CopyStrategy copyFile(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("copyFile");
+
+    try {
+        return _copyFileChecked(src, dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+        return CopyStrategy::NONE;
+    }
+}
+
+// @brief The #copy, the failure of the check is reported by ec and the others are thrown.
+BTF_API void _copy(const Entry& from, const String& dst, bool isOverwrite, const CopyCallback& onFile,
+                   std::error_code& ec)
+{
+    ec.clear();
+
+    const String& src = from.path();
+
+    // If the source path equals the destination path, do nothing.
+    if (isEqualPath(src, dst))
+        return;
+
+    if (from.error()) {
+        ec = from.error();
+        return;
+    }
+
+    Entry to(dst);
+
+    if (from.isFile()) {
+        CopyStrategy strategy = _copyFile(src, to, isOverwrite);
+
+        if (onFile)
+            onFile(src, strategy);
+    } else if (from.isDirectory()) {
+        // If the destination path has a same name file (not directory), it is an error.
+        if (to.isFile()) {
+            ec = Errc::DESTINATION_IS_FILE;
+            return;
+        }
+
+        // If attempt to copy a directory to a subdirectory, it is an error.
+        if (isSubPath(dst, src)) {
+            ec = Errc::COPY_TO_SUBDIRECTORY;
+            return;
+        }
+
+        if (!to.isDirectory())
+            createDirectorys(dst);
+
+        // For each file in the source directory, copy it to the destination directory.
+        // The directories are walked before their children, so the parents of destination always exist,
+        // and the types of source are read from the directory, only the destination is stat once.
+        PathBuilder target(dst);
+        _EntryStat stat;
+        Walker walker(src);
+        while (walker.next()) {
+            target.join(walker.path(), src.size());
+
+            if (walker.isFile()) {
+                _statEntry(target.path(), stat);
+                CopyStrategy strategy = _copyFile(walker.path(), target.path(), stat, isOverwrite, true);
+
+                if (onFile)
+                    onFile(walker.path(), strategy);
+            } else if (walker.isDirectory()) {
+                createDirectory(target.path());
+            }
+        }
+    } else {
+        ec = Errc::SOURCE_NOT_EXISTS;
+    }
+}
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("copy");
+
+    std::error_code ec;
+    _copy(Entry(src), dst, isOverwrite, nullptr, ec);
+    _throwIf(ec, src, dst);
+}
+
+BTF_API void copy(const Entry& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("copy");
+
+    std::error_code ec;
+    _copy(src, dst, isOverwrite, nullptr, ec);
+    _throwIf(ec, src.path(), dst);
+}
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("copy");
+
+    try {
+        _copy(Entry(src), dst, isOverwrite, nullptr, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API void copy(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("copy");
+
+    try {
+        _copy(src, dst, isOverwrite, nullptr, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, const CopyCallback& onFile)
+{
+    _BETTERFILE_SCOPE("copy");
+
+    std::error_code ec;
+    _copy(Entry(src), dst, isOverwrite, onFile, ec);
+    _throwIf(ec, src, dst);
+}
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, const CopyCallback& onFile,
+                  std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("copy");
+
+    try {
+        _copy(Entry(src), dst, isOverwrite, onFile, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+// @brief The #copy by the backend, the failure of the check is reported by ec and the others are thrown.
+BTF_API void _copy(const String& src, const String& dst, bool isOverwrite, IoBackend backend, std::error_code& ec)
+{
+    Entry from(src);
+
+    // The single file has nothing to batch.
+    if (backend != IoBackend::IO_URING || !isIoUringAvailable() || !from.isDirectory() || isEqualPath(src, dst)) {
+        _copy(from, dst, isOverwrite, nullptr, ec);
+        return;
+    }
+
+    ec.clear();
+
+    if (Entry(dst).isFile()) {
+        ec = Errc::DESTINATION_IS_FILE;
+        return;
+    }
+
+    if (isSubPath(dst, src)) {
+        ec = Errc::COPY_TO_SUBDIRECTORY;
+        return;
+    }
+
+    // The directories are created and the destinations are prepared first, then the files are copied in batches.
+    Vec<_IoTask> tasks;
+
+    createDirectorys(dst);
+
+    PathBuilder to(dst);
+    _EntryStat stat;
+    Walker walker(src);
+    while (walker.next()) {
+        to.join(walker.path(), src.size());
+
+        if (walker.isDirectory()) {
+            createDirectory(to.path());
+        } else if (walker.isFile()) {
+            _statEntry(to.path(), stat);
+
+            if (!_prepareCopyFile(walker.path(), to.path(), stat, isOverwrite, true))
+                continue;
+
+            _IoTask task;
+            task.kind = _IoTask::COPY;
+            task.path = walker.path();
+            task.dstPath = to.path();
+
+            tasks.emplace_back(std::move(task));
+        }
+    }
+
+    if (!_runIoBatch(tasks)) {
+        for (const auto& var : tasks)
+            copyFileData(var.path, var.dstPath);
+    }
+}
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, IoBackend backend)
+{
+    _BETTERFILE_SCOPE("copy");
+
+    std::error_code ec;
+    _copy(src, dst, isOverwrite, backend, ec);
+    _throwIf(ec, src, dst);
+}
+
+BTF_API void copy(const String& src, const String& dst, bool isOverwrite, IoBackend backend,
+                  std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("copy");
+
+    try {
+        _copy(src, dst, isOverwrite, backend, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+// @brief The #parallelCopy, the failure of the check is reported by ec and the others are thrown.
+BTF_API CopyStats _parallelCopy(const String& src, const String& dst, bool isOverwrite, uint threadCount,
+                                const CopyCallback& onFile, std::error_code& ec)
+{
+    ec.clear();
+
+    auto start = std::chrono::steady_clock::now();
+    CopyStats stats;
+
+    // If the source path equals the destination path, do nothing.
+    if (isEqualPath(src, dst))
+        return stats;
+
+    Entry from(src);
+
+    if (from.error()) {
+        ec = from.error();
+        return stats;
+    }
+
+    if (from.isFile()) {
+        CopyStrategy strategy = _copyFile(src, Entry(dst), isOverwrite);
+
+        if (strategy != CopyStrategy::NONE) {
+            stats.files = 1;
+            stats.bytes = from.size();
+        } else {
+            stats.skippedFiles = 1;
+        }
+
+        stats.strategyCounts[static_cast<size_t>(strategy)] = 1;
+
+        if (onFile)
+            onFile(src, strategy);
+    } else if (from.isDirectory()) {
+        // If the destination path has a same name file (not directory), it is an error.
+        if (Entry(dst).isFile()) {
+            ec = Errc::DESTINATION_IS_FILE;
+            return stats;
+        }
+
+        // If attempt to copy a directory to a subdirectory, it is an error.
+        if (isSubPath(dst, src)) {
+            ec = Errc::COPY_TO_SUBDIRECTORY;
+            return stats;
+        }
+
+        createDirectorys(dst);
+
+        std::atomic<size_t> files{0};
+        std::atomic<size_t> skippedFiles{0};
+        std::atomic<size_t> dirs{1};
+        std::atomic<size_t> bytes{0};
+        std::atomic<size_t> strategyCounts[COPY_STRATEGY_COUNT] = {};
+
+        // The enumeration task of a directory, it creates the subdirectories of destination
+        // and submits a task for each file and each subdirectory.
+        std::function<void(const String&, const String&)> copyDir;
+        _WorkStealingPool pool(threadCount);
+
+        copyDir = [&](const String& from, const String& to) {
+            Walker walker(from, false);
+
+            while (walker.next()) {
+                String target = pathcat(to, walker.name());
+
+                if (walker.isFile()) {
+                    String _src = walker.path();
+                    size_t size = walker.size();
+
+                    pool.submit([&, _src, target, size]() {
+                        _EntryStat stat;
+                        _statEntry(target, stat);
+
+                        CopyStrategy strategy = _copyFile(_src, target, stat, isOverwrite, true);
+                        strategyCounts[static_cast<size_t>(strategy)].fetch_add(1, std::memory_order_relaxed);
+
+                        if (strategy != CopyStrategy::NONE) {
+                            files.fetch_add(1, std::memory_order_relaxed);
+                            bytes.fetch_add(size, std::memory_order_relaxed);
+                        } else {
+                            skippedFiles.fetch_add(1, std::memory_order_relaxed);
+                        }
+
+                        if (onFile)
+                            onFile(_src, strategy);
+                    });
+                } else if (walker.isDirectory()) {
+                    createDirectory(target);
+                    dirs.fetch_add(1, std::memory_order_relaxed);
+
+                    // Same as #copy, the symlinks to directory are not descended (just create the directory).
+                    if (walker.isSymlink())
+                        continue;
+
+                    String _from = walker.path();
+                    pool.submit([&copyDir, _from, target]() { copyDir(_from, target); });
+                }
+            }
+        };
+
+        pool.submit([&copyDir, &src, &dst]() { copyDir(src, dst); });
+        pool.wait();
+
+        stats.files = files.load();
+        stats.skippedFiles = skippedFiles.load();
+        stats.dirs = dirs.load();
+        stats.bytes = bytes.load();
+
+        for (uint i = 0; i < COPY_STRATEGY_COUNT; ++i)
+            stats.strategyCounts[i] = strategyCounts[i].load();
+    } else {
+        ec = Errc::SOURCE_NOT_EXISTS;
+        return stats;
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return stats;
+}
+
+BTF_API CopyStats parallelCopy(const String& src, const String& dst, bool isOverwrite, uint threadCount,
+                               const CopyCallback& onFile)
+{
+    _BETTERFILE_SCOPE("parallelCopy");
+
+    std::error_code ec;
+    CopyStats stats = _parallelCopy(src, dst, isOverwrite, threadCount, onFile, ec);
+    _throwIf(ec, src, dst);
+
+    return stats;
+}
+
+BTF_API CopyStats parallelCopy(const String& src, const String& dst, bool isOverwrite, uint threadCount,
+                               const CopyCallback& onFile, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("parallelCopy");
+
+    try {
+        return _parallelCopy(src, dst, isOverwrite, threadCount, onFile, ec);
+    } catch (...) {
+        ec = _currentError();
+        return CopyStats();
+    }
+}
+
+BTF_API CopyStats parallelCopy(const String& src, const String& dst, bool isOverwrite, uint threadCount,
+                               std::error_code& ec) noexcept
+{
+    return parallelCopy(src, dst, isOverwrite, threadCount, nullptr, ec);
+}
+
+BTF_API void _setMtime(const String& path, int64_t mtime)
+{
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+#ifdef _BETTERFILE_LINUX
+    struct timespec times[2];
+    times[0].tv_sec = 0;
+    times[0].tv_nsec = UTIME_OMIT;
+    times[1].tv_sec = static_cast<time_t>(mtime / 1000000000);
+    times[1].tv_nsec = static_cast<long>(mtime % 1000000000);
+
+    // The time before the epoch.
+    if (times[1].tv_nsec < 0) {
+        times[1].tv_sec -= 1;
+        times[1].tv_nsec += 1000000000;
+    }
+
+    if (::utimensat(AT_FDCWD, path.c_str(), times, 0) != 0)
+        throw _SystemError(_lastError(),
+                           _fmt("Failed to set the mtime of the file: \"{}\" ({})", path, std::strerror(errno)));
+#else
+    fs::last_write_time(path, fs::file_time_type(std::chrono::duration_cast<fs::file_time_type::duration>(
+                                  std::chrono::nanoseconds(mtime))));
+#endif // _BETTERFILE_LINUX
+}
+
+// @brief Delete the entry of destination which is not in the source, and count it to the statistics.
+BTF_API void _deleteExtra(const String& path, EntryType type, SyncStats& stats)
+{
+    if (type == EntryType::DIRECTORY && !isSymlink(path)) {
+        ++stats.deletedDirs;
+
+        Walker walker(path);
+        while (walker.next()) {
+            if (walker.isDirectory() && !walker.isSymlink()) {
+                ++stats.deletedDirs;
+            } else {
+                ++stats.deletedFiles;
+                stats.deletedBytes += walker.isSymlink() ? 0 : walker.size();
+            }
+        }
+    } else {
+        ++stats.deletedFiles;
+        stats.deletedBytes += type == EntryType::FILE && !isSymlink(path) ? sizes(path) : 0;
+    }
+
+    deletes(path);
+}
+
+BTF_API void _mirrorFile(const Entry& from, const String& dst, const SyncOptions& options, SyncStats& stats)
+{
+    const String& src = from.path();
+    Entry to(dst);
+
+    if (to.isFile() && to.size() == from.size()) {
+        // Only the files of different mtime are hashed, so the unchanged tree is not read again on each run.
+        bool isSame = to.mtime() == from.mtime() || (options.isCompareHash && hashFile(src) == hashFile(dst));
+
+        if (isSame) {
+            // The content is same, sync the mtime so the next mirror can skip it without hashing.
+            if (options.isPreserveMtime && to.mtime() != from.mtime())
+                _setMtime(dst, from.mtime());
+
+            ++stats.skippedFiles;
+            stats.skippedBytes += from.size();
+            return;
+        }
+    }
+
+    // The old file is deleted rather than truncated, so its other hardlinks are not modified.
+    if (to.isFile())
+        deletes(dst);
+    else if (to.isExists() || to.isSymlink())
+        _deleteExtra(dst, to.type(), stats);
+
+    copyFileData(src, dst);
+
+    if (options.isPreserveMtime)
+        _setMtime(dst, from.mtime());
+
+    ++stats.copiedFiles;
+    stats.copiedBytes += from.size();
+}
+
+BTF_API void _mirrorDir(const String& src, const String& dst, const SyncOptions& options, SyncStats& stats)
+{
+    Entry to(dst);
+
+    if (!to.isDirectory()) {
+        if (to.isExists() || to.isSymlink())
+            _deleteExtra(dst, to.type(), stats);
+
+        createDirectorys(dst);
+    }
+
+    ++stats.dirs;
+
+    std::unordered_set<String> names;
+    Strings subdirs;
+
+    // The subdirectories are mirrored after the walker is closed, so the opened streams are not piled up.
+    PathBuilder builder(dst);
+    Walker walker(src, false);
+    while (walker.next()) {
+        const String& target = builder.join(walker.name());
+
+        if (options.isDeleteExtras)
+            names.insert(walker.name());
+
+        if (walker.isFile()) {
+            _mirrorFile(walker.entry(), target, options, stats);
+        } else if (walker.isDirectory() && walker.isSymlink()) {
+            Entry targetEntry(target);
+
+            if (!targetEntry.isDirectory()) {
+                if (targetEntry.isExists() || targetEntry.isSymlink())
+                    _deleteExtra(target, targetEntry.type(), stats);
+
+                createDirectorys(target);
+            }
+        } else if (walker.isDirectory()) {
+            subdirs.push_back(walker.name());
+        }
+    }
+
+    if (options.isDeleteExtras) {
+        Vec<std::pair<String, EntryType>> extras;
+
+        Walker dstWalker(dst, false);
+        while (dstWalker.next()) {
+            if (names.find(dstWalker.name()) == names.end())
+                extras.emplace_back(dstWalker.path(), dstWalker.type());
+        }
+
+        for (const auto& var : extras)
+            _deleteExtra(var.first, var.second, stats);
+    }
+
+    for (const auto& var : subdirs)
+        _mirrorDir(pathcat(src, var), pathcat(dst, var), options, stats);
+}
+
+// @brief The #mirror, the failure of the check is reported by ec and the others are thrown.
+BTF_API SyncStats _mirror(const String& src, const String& dst, const SyncOptions& options, std::error_code& ec)
+{
+    ec.clear();
+
+    auto start = std::chrono::steady_clock::now();
+    SyncStats stats;
+
+    // If the source path equals the destination path, do nothing.
+    if (isEqualPath(src, dst))
+        return stats;
+
+    Entry from(src);
+
+    if (from.error()) {
+        ec = from.error();
+        return stats;
+    }
+
+    if (from.isFile()) {
+        _mirrorFile(from, dst, options, stats);
+    } else if (from.isDirectory()) {
+        // If attempt to mirror a directory to a subdirectory, it is an error.
+        if (isSubPath(dst, src)) {
+            ec = Errc::COPY_TO_SUBDIRECTORY;
+            return stats;
+        }
+
+        _mirrorDir(src, dst, options, stats);
+    } else {
+        ec = Errc::SOURCE_NOT_EXISTS;
+        return stats;
+    }
+
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    return stats;
+}
+
+BTF_API SyncStats mirror(const String& src, const String& dst, const SyncOptions& options)
+{
+    _BETTERFILE_SCOPE("mirror");
+
+    std::error_code ec;
+    SyncStats stats = _mirror(src, dst, options, ec);
+    _throwIf(ec, src, dst);
+
+    return stats;
+}
+
+BTF_API SyncStats mirror(const String& src, const String& dst, const SyncOptions& options,
+                         std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("mirror");
+
+    try {
+        return _mirror(src, dst, options, ec);
+    } catch (...) {
+        ec = _currentError();
+        return SyncStats();
+    }
+}
+
+BTF_API void copySymlink(const String& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("copySymlink");
+
+    Entry to(dst);
+
+    if (!isOverwrite && to.isExists())
+        return;
+
+    if (to.isExists() || to.isSymlink())
+        deletes(dst);
+
+    fs::copy_symlink(src, dst);
+}
+
+BTF_API void copySymlink(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("copySymlink");
+
+    Entry to(dst);
+    ec = to.error();
+
+    if (ec || (!isOverwrite && to.isExists()))
+        return;
+
+    if (to.isExists() || to.isSymlink())
+        deletes(dst, ec);
+
+    if (!ec)
+        fs::copy_symlink(src, dst, ec);
+}
+
+// @brief Rename the path to the destination only if the destination not exists (atomically if supported).
+// @return The error, std::errc::file_exists if the destination exists.
+BTF_API std::error_code _renameNoReplace(const String& src, const String& dst)
+{
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+#if defined(_BETTERFILE_LINUX) && defined(SYS_renameat2)
+    if (::syscall(SYS_renameat2, AT_FDCWD, src.c_str(), AT_FDCWD, dst.c_str(), RENAME_NOREPLACE) == 0)
+        return std::error_code();
+
+    // The kernel or the filesystem doesn't support the flag, fallback to check then rename.
+    if (errno != ENOSYS && errno != EINVAL)
+        return std::error_code(errno, std::generic_category());
+#endif // defined(_BETTERFILE_LINUX) && defined(SYS_renameat2)
+
+    std::error_code ec;
+
+    if (fs::exists(fs::symlink_status(dst, ec)))
+        return std::make_error_code(std::errc::file_exists);
+
+    fs::rename(src, dst, ec);
+
+    return ec;
+}
+
+// @brief Move the file (or the symlink itself) by the rules of #move, the parent of destination must exists.
+BTF_API void _moveFile(const String& src, const String& dst, bool isOverwrite)
+{
+    std::error_code ec;
+
+    if (isOverwrite)
+        fs::rename(src, dst, ec);
+    else
+        ec = _renameNoReplace(src, dst);
+
+    if (!ec || (!isOverwrite && ec == std::errc::file_exists))
+        return;
+
+    Entry to(dst);
+
+    if (to.isDirectory())
+        _throwIf(Errc::DESTINATION_IS_DIRECTORY, src, dst);
+
+    if (ec != std::errc::cross_device_link)
+        throw _SystemError(ec, _fmt("Failed to move the file: \"{}\" -> \"{}\" ({})", src, dst, ec.message()));
+
+    if (isSymlink(src))
+        copySymlink(src, dst, isOverwrite);
+    else if (_prepareCopyFile(src, to, isOverwrite, true))
+        copyFileData(src, dst);
+    else
+        return;
+
+    fs::remove(src);
+}
+
+// @brief Move the directory across the filesystems by a pool of workers, each file is deleted after it is copied,
+// and the source directories are deleted at last if they are empty (the files skipped are left).
+BTF_API void _moveDirAcrossDevice(const String& src, const String& dst, bool isOverwrite)
+{
+    Strings dirs;
+    std::mutex dirsMtx;
+    std::function<void(const String&, const String&)> moveDir;
+    _WorkStealingPool pool;
+
+    moveDir = [&](const String& from, const String& to) {
+        Entry target(to);
+
+        if (target.isFile())
+            _throwIf(Errc::DESTINATION_IS_FILE, from, to);
+
+        // The parent is created before its children are submitted.
+        if (!target.isDirectory())
+            createDirectory(to);
+
+        {
+            std::lock_guard<std::mutex> lock(dirsMtx);
+            dirs.push_back(from);
+        }
+
+        Walker walker(from, false);
+        while (walker.next()) {
+            String _from = walker.path();
+            String target = pathcat(to, walker.name());
+
+            if (walker.isDirectory() && !walker.isSymlink())
+                pool.submit([&moveDir, _from, target]() { moveDir(_from, target); });
+            else if (walker.isFile() || walker.isSymlink())
+                pool.submit([_from, target, isOverwrite]() { _moveFile(_from, target, isOverwrite); });
+        }
+    };
+
+    pool.submit([&moveDir, &src, &dst]() { moveDir(src, dst); });
+    pool.wait();
+
+    // The children are pushed after the parent, so the deeper directories are deleted first.
+    std::sort(dirs.begin(), dirs.end(), [](const String& a, const String& b) { return a.size() > b.size(); });
+
+    for (const auto& var : dirs) {
+        std::error_code ec;
+        fs::remove(var, ec);
+    }
+}
+
+// @brief Move the directory by the rules of #move, the parent of destination must exists.
+// If the destination not exists, the whole tree is moved by a single rename,
+// else the children are merged into the destination recursively.
+BTF_API void _moveDir(const String& src, const String& dst, bool isOverwrite)
+{
+    std::error_code ec = _renameNoReplace(src, dst);
+
+    if (!ec)
+        return;
+
+    if (ec == std::errc::cross_device_link) {
+        _moveDirAcrossDevice(src, dst, isOverwrite);
+        return;
+    }
+
+    if (ec != std::errc::file_exists && ec != std::errc::directory_not_empty)
+        throw _SystemError(ec, _fmt("Failed to move the directory: \"{}\" -> \"{}\" ({})", src, dst, ec.message()));
+
+    if (!Entry(dst).isDirectory())
+        _throwIf(Errc::DESTINATION_IS_FILE, src, dst);
+
+    // The entries are read first, the directory is not modified while it is read.
+    Strings files;
+    Strings dirs;
+
+    Walker walker(src, false);
+    while (walker.next()) {
+        if (walker.isDirectory() && !walker.isSymlink())
+            dirs.push_back(walker.name());
+        else if (walker.isFile() || walker.isSymlink())
+            files.push_back(walker.name());
+    }
+
+    PathBuilder from(src);
+    PathBuilder to(dst);
+
+    for (const auto& var : files)
+        _moveFile(from.join(var), to.join(var), isOverwrite);
+
+    for (const auto& var : dirs)
+        _moveDir(from.join(var), to.join(var), isOverwrite);
+
+    // The source is left if some entries are not moved.
+    fs::remove(src, ec);
+}
+
+// @brief The #move, the failure of the check is reported by ec and the others are thrown.
+BTF_API void _move(const Entry& from, const String& dst, bool isOverwrite, std::error_code& ec)
+{
+    ec.clear();
+
+    const String& src = from.path();
+
+    // If the source path equals the destination path, do nothing.
+    if (isEqualPath(src, dst))
+        return;
+
+    if (from.error()) {
+        ec = from.error();
+        return;
+    }
+
+    Entry to(dst);
+
+    if (from.isFile()) {
+        // If the destination path exists same name file or directory and specified not overwrite, do nothing.
+        if (!isOverwrite && to.isExists())
+            return;
+
+        // If the destination path has a same name directory (not file), it is an error.
+        if (to.isDirectory()) {
+            ec = Errc::DESTINATION_IS_DIRECTORY;
+            return;
+        }
+
+        // Create the parent directory of the destination path first if not exists.
+        _createParentOf(to);
+
+        _moveFile(src, dst, isOverwrite);
+    } else if (from.isDirectory()) {
+        // If the destination path has a same name file (not directory), it is an error.
+        if (to.isFile()) {
+            ec = Errc::DESTINATION_IS_FILE;
+            return;
+        }
+
+        // If attempt to move a directory to a subdirectory, it is an error.
+        if (isSubPath(dst, src)) {
+            ec = Errc::MOVE_TO_SUBDIRECTORY;
+            return;
+        }
+
+        // Create the parent directory of the destination path first if not exists.
+        _createParentOf(to);
+
+        _moveDir(src, dst, isOverwrite);
+    } else {
+        ec = Errc::SOURCE_NOT_EXISTS;
+    }
+}
+
+BTF_API void move(const String& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("move");
+
+    std::error_code ec;
+    _move(Entry(src), dst, isOverwrite, ec);
+    _throwIf(ec, src, dst);
+}
+
+BTF_API void move(const Entry& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("move");
+
+    std::error_code ec;
+    _move(src, dst, isOverwrite, ec);
+    _throwIf(ec, src.path(), dst);
+}
+
+BTF_API void move(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("move");
+
+    try {
+        _move(Entry(src), dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API void move(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("move");
+
+    try {
+        _move(src, dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API void reFilename(const String& path, const String& newFilename, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("reFilename");
+
+    auto dst = pathcat(parentPath(path), newFilename + extension(path));
+    move(path, dst, isOverwrite);
+}
+
+BTF_API void reFilename(const String& path, const String& newFilename, bool isOverwrite,
+                        std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("reFilename");
+
+    try {
+        auto dst = pathcat(parentPath(path), newFilename + extension(path));
+        move(path, dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API void reFilenameEx(const String& path, const String& newFilenameEx, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("reFilenameEx");
+
+    auto dst = pathcat(parentPath(path), newFilenameEx);
+    move(path, dst, isOverwrite);
+}
+
+BTF_API void reFilenameEx(const String& path, const String& newFilenameEx, bool isOverwrite,
+                          std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("reFilenameEx");
+
+    try {
+        auto dst = pathcat(parentPath(path), newFilenameEx);
+        move(path, dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API void reExtension(const String& path, const String& newExtension, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("reExtension");
+
+    auto dst = pathcat(parentPath(path), filename(path) + newExtension);
+    move(path, dst, isOverwrite);
+}
+
+BTF_API void reExtension(const String& path, const String& newExtension, bool isOverwrite,
+                         std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("reExtension");
+
+    try {
+        auto dst = pathcat(parentPath(path), filename(path) + newExtension);
+        move(path, dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+// @brief The #createSymlink, the failure of the check is reported by ec and the others are thrown.
+BTF_API void _createSymlink(const Entry& from, const String& dst, bool isOverwrite, std::error_code& ec)
+{
+    ec.clear();
+
+    const String& src = from.path();
+
+    // If the source path equals the destination path, do nothing.
+    if (isEqualPath(src, dst))
+        return;
+
+    if (from.error()) {
+        ec = from.error();
+        return;
+    }
+
+    Entry to(dst);
+
+    // If the destination path exists same name file or directory and specified not overwrite, do nothing.
+    if (!isOverwrite && to.isExists())
+        return;
+
+    if (from.isFile()) {
+        // If the destination path has a same name directory (not file), it is an error.
+        if (to.isDirectory()) {
+            ec = Errc::DESTINATION_IS_DIRECTORY;
+            return;
+        }
+    } else if (from.isDirectory()) {
+        // If the destination path has a same name file (not directory), it is an error.
+        if (to.isFile()) {
+            ec = Errc::DESTINATION_IS_FILE;
+            return;
+        }
+    } else {
+        ec = Errc::PATH_NOT_EXISTS;
+        return;
+    }
+
+    // Create the parent directory of the destination path first if not exists, else delete the old one.
+    if (to.isExists() || to.isSymlink())
+        deletes(dst);
+    else
+        _createParentOf(to);
+
+    if (from.isFile())
+        fs::create_symlink(src, dst);
+    else
+        fs::create_directory_symlink(src, dst);
+}
+
+BTF_API void createSymlink(const String& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("createSymlink");
+
+    std::error_code ec;
+    _createSymlink(Entry(src), dst, isOverwrite, ec);
+    _throwIf(ec, src, dst);
+}
+
+BTF_API void createSymlink(const Entry& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("createSymlink");
+
+    std::error_code ec;
+    _createSymlink(src, dst, isOverwrite, ec);
+    _throwIf(ec, src.path(), dst);
+}
+
+BTF_API void createSymlink(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("createSymlink");
+
+    try {
+        _createSymlink(Entry(src), dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API void createSymlink(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("createSymlink");
+
+    try {
+        _createSymlink(src, dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API String symlinkTarget(const String& path)
+{
+    _BETTERFILE_SCOPE("symlinkTarget");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::read_symlink(path).string();
+}
+
+BTF_API String symlinkTarget(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("symlinkTarget");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    try {
+        return fs::read_symlink(path, ec).string();
+    } catch (...) {
+        ec = _currentError();
+        return String();
+    }
+}
+
+// @brief The #createHardlink, the failure of the check is reported by ec and the others are thrown.
+BTF_API void _createHardlink(const Entry& from, const String& dst, bool isOverwrite, std::error_code& ec)
+{
+    ec.clear();
+
+    const String& src = from.path();
+
+    // If the source path equals the destination path, do nothing.
+    if (isEqualPath(src, dst))
+        return;
+
+    if (from.error()) {
+        ec = from.error();
+        return;
+    }
+
+    if (from.isFile()) {
+        Entry to(dst);
+
+        if (!isOverwrite && to.isExists())
+            return;
+
+        // If the destination path has a same name directory (not file), it is an error.
+        if (to.isDirectory()) {
+            ec = Errc::DESTINATION_IS_DIRECTORY;
+            return;
+        }
+
+        // Create the parent directory of the destination path first if not exists, else delete the old one.
+        if (to.isExists() || to.isSymlink())
+            deletes(dst);
+        else
+            _createParentOf(to);
+
+        fs::create_hard_link(src, dst);
+    } else if (from.isDirectory()) {
+        ec = Errc::HARDLINK_DIRECTORY;
+    } else {
+        ec = Errc::PATH_NOT_EXISTS;
+    }
+}
+
+BTF_API void createHardlink(const String& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("createHardlink");
+
+    std::error_code ec;
+    _createHardlink(Entry(src), dst, isOverwrite, ec);
+    _throwIf(ec, src, dst);
+}
+
+BTF_API void createHardlink(const Entry& src, const String& dst, bool isOverwrite)
+{
+    _BETTERFILE_SCOPE("createHardlink");
+
+    std::error_code ec;
+    _createHardlink(src, dst, isOverwrite, ec);
+    _throwIf(ec, src.path(), dst);
+}
+
+BTF_API void createHardlink(const String& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("createHardlink");
+
+    try {
+        _createHardlink(Entry(src), dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API void createHardlink(const Entry& src, const String& dst, bool isOverwrite, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("createHardlink");
+
+    try {
+        _createHardlink(src, dst, isOverwrite, ec);
+    } catch (...) {
+        ec = _currentError();
+    }
+}
+
+BTF_API size_t hardlinkCount(const String& path)
+{
+    _BETTERFILE_SCOPE("hardlinkCount");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    return fs::hard_link_count(path);
+}
+
+BTF_API size_t hardlinkCount(const String& path, std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("hardlinkCount");
+    _BETTERFILE_COUNT(SYSCALLS, 1);
+
+    size_t count = static_cast<size_t>(fs::hard_link_count(path, ec));
+    return ec ? 0 : count;
+}
+
+BTF_API String tempDirectory()
+{
+    _BETTERFILE_SCOPE("tempDirectory");
+
+    return fs::temp_directory_path().string();
+}
+
+BTF_API String tempDirectory(std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("tempDirectory");
+
+    try {
+        return fs::temp_directory_path(ec).string();
+    } catch (...) {
+        ec = _currentError();
+        return String();
+    }
+}
+
+BTF_API bool isIoUringAvailable()
+{
+    _BETTERFILE_SCOPE("isIoUringAvailable");
+
+    static const bool isAvailable = _isIoUringSupported();
+    return isAvailable;
+}
+
+// @brief The #getAlls, the failure of the check is reported by ec and the others are thrown.
+BTF_API std::pair<Strings, Strings>
+_getAlls(const String& path, bool isRecursive, bool (*filter)(const String&), std::error_code& ec)
+{
+    ec.clear();
+
+    if (!isDirectory(path)) {
+        ec = Errc::NOT_DIRECTORY;
+        return {};
+    }
+
+    Strings files;
+    Strings dirs;
+
+    // The filter is called with the reused path buffer, the string is only copied if accepted.
+    Walker walker(path, isRecursive);
+    while (walker.next()) {
+        if (walker.isFile() && (filter == nullptr || filter(walker.path())))
+            files.push_back(walker.path());
+
+        if (walker.isDirectory() && (filter == nullptr || filter(walker.path())))
+            dirs.push_back(walker.path());
+    }
+
+    return { files, dirs };
+}
+
+// @return The pair of files and directorys.
+BTF_API std::pair<Strings, Strings>
+getAlls(const String& path, bool isRecursive, bool (*filter)(const String&))
+{
+    _BETTERFILE_SCOPE("getAlls");
+
+    std::error_code ec;
+    auto rslt = _getAlls(path, isRecursive, filter, ec);
+    _throwIf(ec, path);
+
+    return rslt;
+}
+
+BTF_API std::pair<Strings, Strings>
+getAlls(const String& path, bool isRecursive, bool (*filter)(const String&), std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("getAlls");
+
+    try {
+        return _getAlls(path, isRecursive, filter, ec);
+    } catch (...) {
+        ec = _currentError();
+        return {};
+    }
+}
+
+// @brief The #getAllFiles, the failure of the check is reported by ec and the others are thrown.
+BTF_API Strings _getAllFiles(const String& path, bool isRecursive, bool (*filter)(const String&),
+                             std::error_code& ec)
+{
+    ec.clear();
+
+    if (!isDirectory(path)) {
+        ec = Errc::NOT_DIRECTORY;
+        return {};
+    }
+
+    Strings files;
+
+    Walker walker(path, isRecursive);
+    while (walker.next()) {
+        if (walker.isFile() && (filter == nullptr || filter(walker.path())))
+            files.push_back(walker.path());
+    }
+
+    return files;
+}
+
+BTF_API Strings getAllFiles(const String& path, bool isRecursive, bool (*filter)(const String&))
+{
+    _BETTERFILE_SCOPE("getAllFiles");
+
+    std::error_code ec;
+    Strings files = _getAllFiles(path, isRecursive, filter, ec);
+    _throwIf(ec, path);
+
+    return files;
+}
+
+BTF_API Strings getAllFiles(const String& path, bool isRecursive, bool (*filter)(const String&),
+                            std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("getAllFiles");
+
+    try {
+        return _getAllFiles(path, isRecursive, filter, ec);
+    } catch (...) {
+        ec = _currentError();
+        return {};
+    }
+}
+
+// @brief The #getAllDirectorys, the failure of the check is reported by ec and the others are thrown.
+BTF_API Strings _getAllDirectorys(const String& path, bool isRecursive, bool (*filter)(const String&),
+                                  std::error_code& ec)
+{
+    ec.clear();
+
+    if (!isDirectory(path)) {
+        ec = Errc::NOT_DIRECTORY;
+        return {};
+    }
+
+    Strings dirs;
+
+    Walker walker(path, isRecursive);
+    while (walker.next()) {
+        if (walker.isDirectory() && (filter == nullptr || filter(walker.path())))
+            dirs.push_back(walker.path());
+    }
+
+    return dirs;
+}
+
+BTF_API Strings getAllDirectorys(const String& path, bool isRecursive, bool (*filter)(const String&))
+{
+    _BETTERFILE_SCOPE("getAllDirectorys");
+
+    std::error_code ec;
+    Strings dirs = _getAllDirectorys(path, isRecursive, filter, ec);
+    _throwIf(ec, path);
+
+    return dirs;
+}
+
+BTF_API Strings getAllDirectorys(const String& path, bool isRecursive, bool (*filter)(const String&),
+                                 std::error_code& ec) noexcept
+{
+    _BETTERFILE_SCOPE("getAllDirectorys");
+
+    try {
+        return _getAllDirectorys(path, isRecursive, filter, ec);
+    } catch (...) {
+        ec = _currentError();
+        return {};
+    }
+}
+
+#endif // !BTF_FWD
+
+} // namespace btf
+
+// Classes.
+namespace btf
+{
+
+#ifndef BTF_IMPL
+
+class File
+{
+public:
+    File() = default;
+
+    explicit File(const String& name) { setName(name); }
+
+    // @note The data is shared (not copied) until one of the files is modified.
+    File(const File& other)
+    {
+        name_ = other.name_;
+
+        // The buffer is copied on write, and the mapped region is read-only, so both can be shared.
+        auto lock = other.lockLazy_();
+        data_ = other.data_;
+        map_ = other.map_;
+
+        diskPath_ = other.diskPath_;
+        diskSize_ = other.diskSize_;
+    }
+
+    File(File&& other) noexcept
+    {
+        name_ = std::move(other.name_);
+
+        data_ = std::move(other.data_);
+
+        map_ = std::move(other.map_);
+
+        diskPath_ = std::move(other.diskPath_);
+        diskSize_ = other.diskSize_;
+    }
+
+    ~File() { releaseData(); }
+
+    // @param mode If the mode is one of the mmap modes, the file is mapped read-only instead of read,
+    // and it is copied to an owned buffer only when modified. If failed to map, fallback to read.
+    // If the mode is LoadMode::DIRECT, the file is read by O_DIRECT, if not supported fallback to read.
+    // If the mode is LoadMode::LAZY, the data is read when it is accessed first, see #isLoaded.
+    static File fromDiskPath(const String& filename, LoadMode mode = LoadMode::READ)
+    {
+        _BETTERFILE_SCOPE("File::fromDiskPath");
+
+        File file(filenameEx(filename));
+
+        if (mode == LoadMode::LAZY) {
+            if (!isFile(filename))
+                throw Exception(_fmt("Failed to open the file: \"{}\"", filename));
+
+            file.diskPath_ = filename;
+            file.diskSize_ = sizes(filename);
+
+            return file;
+        }
+
+        if (mode == LoadMode::MMAP || mode == LoadMode::MMAP_POPULATE || mode == LoadMode::MMAP_SEQUENTIAL) {
+            file.map_ = _MappedRegion::map(filename, mode);
+
+            if (file.map_)
+                return file;
+        }
+
+#ifdef _BETTERFILE_LINUX
+        if (mode == LoadMode::DIRECT) {
+            file.detach_();
+
+            if (_readDirect(filename, *file.data_, _LARGE_BUFFER_SIZE))
+                return file;
+        }
+
+        _Fd fd(::open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+
+        if (!fd.valid())
+            throw Exception(_fmt("Failed to open the file: \"{}\"", filename));
+
+        file.read(fd.get());
+#else
+        std::ifstream ifs(filename, std::ios_base::binary);
+
+        if (!ifs.is_open())
+            throw Exception(_fmt("Failed to open the file: \"{}\"", filename));
+
+        file << ifs;
+
+        ifs.close();
+#endif // _BETTERFILE_LINUX
+
+        return file;
+    }
+
+    // @brief Read the data into the arena, the file refers to the data read-only (as same as the mapped data)
+    // and shares the ownership of the arena. The data is copied to an owned buffer only when modified.
+    static File fromDiskPath(const String& filename, const std::shared_ptr<Arena>& arena)
+    {
+        _BETTERFILE_SCOPE("File::fromDiskPath");
+
+        File file(filenameEx(filename));
+
+#ifdef _BETTERFILE_LINUX
+        _Fd fd(::open(filename.c_str(), O_RDONLY | O_CLOEXEC));
+
+        if (!fd.valid())
+            throw Exception(_fmt("Failed to open the file: \"{}\"", filename));
+
+        struct stat st;
+        if (::fstat(fd.get(), &st) != 0)
+            throw _SystemError(_lastError(),
+                               _fmt("Failed to stat the file: \"{}\" ({})", filename, std::strerror(errno)));
+
+        size_t size = static_cast<size_t>(st.st_size);
+        char* data = static_cast<char*>(arena->allocate(size, 1));
+        size_t used = 0;
+
+        // The data is read by the size when opened, the data appended later is ignored.
+        while (used < size) {
+            ssize_t n = ::read(fd.get(), data + used, size - used);
+
+            if (n < 0 && errno == EINTR)
+                continue;
+
+            if (n < 0)
+                throw _SystemError(_lastError(),
+                                   _fmt("Failed to read the file: \"{}\" ({})", filename, std::strerror(errno)));
+
+            if (n == 0)
+                break;
+
+            used += static_cast<size_t>(n);
+        }
+#else
+        std::ifstream ifs(filename, std::ios_base::binary);
+
+        if (!ifs.is_open())
+            throw Exception(_fmt("Failed to open the file: \"{}\"", filename));
+
+        size_t size = sizes(filename);
+        char* data = static_cast<char*>(arena->allocate(size, 1));
+
+        ifs.read(data, size);
+        size_t used = static_cast<size_t>(ifs.gcount());
+#endif // _BETTERFILE_LINUX
+
+        file.map_ = _MappedRegion::fromArena(arena, data, used);
+
+        return file;
+    }
+
+    const String& name() const { return name_; }
+
+    String data() const
+    {
+        load_();
+
+        if (data_ == nullptr)
+            return String(cdata(), size());
+        return *data_;
+    }
+
+    // @return The view of the data without copy, it is valid until the file is modified or released.
+    StringView dataView() const
+    {
+        load_();
+        return StringView(cdata(), size());
+    }
+
+    // @brief Move the data out of the file without copy (the shared or mapped data is copied),
+    // the file has no data (and is not linked to the disk) after it.
+    String takeData()
+    {
+        detach_();
+
+        String data = std::move(*data_);
+        releaseData();
+
+        return data;
+    }
+
+    // @return The pointer to the data, it is valid until the file is modified or released.
+    // If the file has no data return nullptr.
+    const char* cdata() const
+    {
+        load_();
+
+        if (data_)
+            return data_->data();
+        if (map_)
+            return map_->data();
+        return nullptr;
+    }
+
+    size_t size() const
+    {
+        auto lock = lockLazy_();
+
+        if (data_)
+            return data_->size();
+        if (map_)
+            return map_->size();
+        return diskSize_;
+    }
+
+    // @return If the data is a read-only mapping of the file on disk return true.
+    bool isMapped() const { return map_ != nullptr && map_->isMapped(); }
+
+    // @return If the data is read-only placed in an arena return true.
+    bool isInArena() const { return map_ != nullptr && !map_->isMapped(); }
+
+    // @return The content hash of the data, see #hash64.
+    // @note If the file is not loaded, the data is hashed from disk by chunks and is not loaded.
+    uint64_t hash() const
+    {
+        if (!isLoaded())
+            return hashFile(diskPath_);
+        return hash64(cdata(), size());
+    }
+
+    // @brief Copy the data into the arena, see #fromDiskPath(const String&, const std::shared_ptr<Arena>&).
+    void setData(const char* data, size_t size, const std::shared_ptr<Arena>& arena)
+    {
+        char* buffer = static_cast<char*>(arena->allocate(size, 1));
+        std::copy(data, data + size, buffer);
+
+        reset_();
+        map_ = _MappedRegion::fromArena(arena, buffer, size);
+    }
+
+    // @return If the file is loaded by LoadMode::LAZY and the data is not read yet (or released) return false.
+    // The size of the not loaded file is the size on disk when it is loaded.
+    bool isLoaded() const
+    {
+        if (diskPath_.empty())
+            return true;
+
+        auto lock = lockLazy_();
+        return data_ != nullptr || map_ != nullptr;
+    }
+
+    // @return The path on disk which the data is read from when accessed, it is empty if the file
+    // is not loaded by LoadMode::LAZY or it is modified.
+    const String& diskPath() const { return diskPath_; }
+
+    bool empty() const { return size() == 0; }
+
+    void setName(const String& name)
+    {
+        if (!isValidFilename(name))
+            throw Exception(_fmt("Invalid file name: \"{}\"", name));
+
+        name_ = name;
+    }
+
+    // @note If the file is loaded by LoadMode::LAZY and not modified, it is not loaded again
+    // and the data will be read when it is accessed next time.
+    void releaseData()
+    {
+        map_.reset();
+        data_.reset();
+    }
+
+    void write(std::ostream& os) const
+    {
+        load_();
+
+        if (size() == 0)
+            return;
+
+        os.write(cdata(), size());
+    }
+
+    void write(const String& path, bool isOverwrite = false,
+               std::ios_base::openmode openmode = std::ios_base::binary) const
+    {
+        _BETTERFILE_SCOPE("File::write");
+
+        String _path = path + PREFERRED_PATH_SEPARATOR + name_;
+
+        if (!isOverwrite && isFile(_path))
+            return;
+
+        // The data is read from the destination itself, so it is written to a temporary file and renamed
+        // into place, else the file would be truncated before its data is read.
+        if (isBackedBy_(_path)) {
+            write(path, true, WriteMode::ATOMIC);
+            return;
+        }
+
+        // The not loaded data is copied from disk directly (kernel-side if possible).
+        if (!isLoaded() && openmode == std::ios_base::binary) {
+            copyFileData(diskPath_, _path);
+            return;
+        }
+
+        // The binary write goes to the file descriptor directly without stream buffering.
+        if (openmode == std::ios_base::binary) {
+            load_();
+            writeFile(_path, cdata(), size());
+            return;
+        }
+
+        std::ofstream ofs(_path.data(), openmode);
+
+        if (!ofs.is_open())
+            throw Exception(_fmt("Failed to open the file: \"{}\"", _path));
+
+        write(ofs);
+
+        ofs.close();
+    }
+
+    // @brief Write the file by binary with the specified durability, see #WriteMode.
+    // @note If the mode is WriteMode::DURABLE, the file and the directory are flushed,
+    // use #Dir::write to write many files with less flushes.
+    void write(const String& path, bool isOverwrite, WriteMode mode) const
+    {
+        _BETTERFILE_SCOPE("File::write");
+
+        if (mode == WriteMode::DEFAULT) {
+            write(path, isOverwrite);
+            return;
+        }
+
+        _IoTask task;
+        task.path = path + PREFERRED_PATH_SEPARATOR + name_;
+
+        if (!isOverwrite && isFile(task.path))
+            return;
+
+        if (isLoaded()) {
+            task.kind = _IoTask::WRITE;
+            task.data = cdata();
+            task.size = size();
+        } else {
+            task.kind = _IoTask::COPY;
+            task.dstPath = std::move(task.path);
+            task.path = diskPath_;
+        }
+
+        _commitWrites(Vec<_IoTask>{std::move(task)}, Strings{path}, mode == WriteMode::DURABLE);
+    }
+
+    File copy() const { return File(*this); }
+
+    File& operator=(const File& other)
+    {
+        if (this == &other)
+            return *this;
+
+        name_ = other.name_;
+
+        releaseData();
+
+        auto lock = other.lockLazy_();
+        data_ = other.data_;
+        map_ = other.map_;
+
+        diskPath_ = other.diskPath_;
+        diskSize_ = other.diskSize_;
+
+        return *this;
+    }
+
+    File& operator=(File&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+
+        name_ = std::move(other.name_);
+
+        releaseData();
+
+        data_ = std::move(other.data_);
+
+        map_ = std::move(other.map_);
+
+        diskPath_ = std::move(other.diskPath_);
+        diskSize_ = other.diskSize_;
+
+        return *this;
+    }
+
+    File& operator=(const String& data)
+    {
+        reset_();
+
+        data_ = std::make_shared<String>(data);
+
+        return *this;
+    }
+
+    // @brief Adopt the buffer of the data without copy.
+    File& operator=(String&& data)
+    {
+        reset_();
+
+        data_ = std::make_shared<String>(std::move(data));
+
+        return *this;
+    }
+
+    template <typename T>
+    File& operator=(const Vec<T>& data)
+    {
+        reset_();
+
+        data_ = std::make_shared<String>();
+        data_->reserve(data_->size() + data.size());
+
+        for (const auto& var : data)
+            data_->push_back(var);
+
+        return *this;
+    }
+
+    File& operator<<(const File& other)
+    {
+        detach_();
+
+        other.load_();
+        if (other.size() > 0)
+            data_->append(other.cdata(), other.size());
+
+        return *this;
+    }
+
+    File& operator<<(std::istream& is) { return read(is); }
+
+    File& operator<<(const String& data)
+    {
+        detach_();
+        data_->append(data);
+
+        return *this;
+    }
+
+    // @brief If the file has no data, adopt the buffer of the data without copy, else append it.
+    File& operator<<(String&& data)
+    {
+        if (size() == 0) {
+            reset_();
+            data_ = std::make_shared<String>(std::move(data));
+        } else {
+            detach_();
+            data_->append(data);
+        }
+
+        return *this;
+    }
+
+    template <typename T>
+    File& operator<<(const Vec<T>& data)
+    {
+        size_t size = data.size();
+
+        detach_();
+        data_->reserve(data_->size() + size);
+
+        for (const auto& var : data)
+            data_->push_back(var);
 
-    if (isFile(src)) {
-        // If the destination path exists same name file or directory and specified not overwrite, do nothing.
-        if (!isOverwrite && isExists(dst))
-            return;
+        return *this;
+    }
 
-        // If the destination path has a same name directory (not file), throw exception.
-        if (isDirectory(dst))
-            throw Exception(_fmt("The destination path contains same name directory. \"{}\" -> \"{}\"", src, dst));
+    // @brief Append all data of the stream, it is read directly into the data buffer.
+    // If the stream is seekable, it is read from the begin and the buffer is resized by the stream size once,
+    // else (e.g. pipe, socket) it is read from the current position and the buffer grows geometrically.
+    // @param bufferSize The max size of each read.
+    File& read(std::istream& is, size_t bufferSize = _LARGE_BUFFER_SIZE)
+    {
+        detach_();
 
-        // Create the parent directory of the destination path first if not exists.
-        if (!isDirectory(parentPath(dst)))
-            createDirectorys(parentPath(dst));
+        size_t used = data_->size();
+        size_t hint = 0;
 
-        fs::rename(src, dst);
-    } else if (isDirectory(src)) {
-        // If the destination path has a same name file (not directory), throw exception.
-        if (isFile(dst))
-            throw Exception(_fmt("The destination path contains same name file. \"{}\" -> \"{}\"", src, dst));
+        // Seek by the stream buffer directly, so the non-seekable stream is not set fail.
+        std::streambuf* buf = is.rdbuf();
+        std::streampos end = buf ? buf->pubseekoff(0, std::ios_base::end, std::ios_base::in) : std::streampos(-1);
+        if (end != std::streampos(-1) && buf->pubseekpos(0, std::ios_base::in) != std::streampos(-1))
+            hint = static_cast<size_t>(end);
 
-        // If attempt to move a directory to a subdirectory, throw exception.
-        if (isSubPath(dst, src))
-            throw Exception(_fmt("Can't move directory to a subdirectory. \"{}\" -> \"{}\"", src, dst));
+        // One more byte than the hint, so the end of stream is detected without grow.
+        data_->resize(used + (hint > 0 ? hint + 1 : bufferSize));
 
-        createDirectorys(dst);
+        while (is) {
+            if (used == data_->size())
+                data_->resize(std::max(data_->size() * 2, used + bufferSize));
 
-        for (const auto& var : fs::directory_iterator(src)) {
-            if (var.is_regular_file()) {
-                move(var.path().string(), pathcat(dst, var.path().string().substr(src.size())), isOverwrite);
-            } else if (var.is_directory()) {
-                move(var.path().string(), pathcat(dst, var.path().string().substr(src.size())), isOverwrite);
-                if (fs::is_empty(var.path()))
-                    fs::remove(var.path());
-            }
+            is.read(&(*data_)[used], std::min(bufferSize, data_->size() - used));
+            used += static_cast<size_t>(is.gcount());
         }
 
-        if (fs::is_empty(src))
-            fs::remove(src);
-    } else {
-        throw Exception(_fmt("The specified source path not exists. \"{}\"", src));
+        data_->resize(used);
+
+        return *this;
     }
-}
 
-BTF_API void reFilename(const String& path, const String& newFilename, bool isOverwrite)
-{
-    auto dst = pathcat(parentPath(path), newFilename + extension(path));
-    move(path, dst, isOverwrite);
-}
+#ifdef _BETTERFILE_LINUX
+    // @brief Append all the rest data of the file descriptor, it is read directly into the data buffer.
+    // @param bufferSize The max size of each read.
+    File& read(int fd, size_t bufferSize = _LARGE_BUFFER_SIZE)
+    {
+        detach_();
 
-BTF_API void reFilenameEx(const String& path, const String& newFilenameEx, bool isOverwrite)
-{
-    auto dst = pathcat(parentPath(path), newFilenameEx);
-    move(path, dst, isOverwrite);
-}
+        if (!_readAll(fd, *data_, bufferSize))
+            throw _SystemError(_lastError(), _fmt("Failed to read the file: \"{}\" ({})", name_, std::strerror(errno)));
 
-BTF_API void reExtension(const String& path, const String& newExtension, bool isOverwrite)
-{
-    auto dst = pathcat(parentPath(path), filename(path) + newExtension);
-    move(path, dst, isOverwrite);
-}
+        return *this;
+    }
+#endif // _BETTERFILE_LINUX
 
-BTF_API void createSymlink(const String& src, const String& dst, bool isOverwrite)
-{
-    // If the source path equals the destination path, do nothing.
-    if (isEqualPath(src, dst))
-        return;
+    const File& operator>>(std::ostream& os) const
+    {
+        write(os);
+        return *this;
+    }
 
-    // If the destination path exists same name file or directory and specified not overwrite, do nothing.
-    if (!isOverwrite && isExists(dst))
-        return;
+private:
+    friend class Pack;
+    friend class Dir;
 
-    if (isFile(src)) {
-        // If the destination path has a same name directory (not file), throw exception.
-        if (isDirectory(dst))
-            throw Exception(_fmt("The destination path contains same name directory. \"{}\" -> \"{}\"", src, dst));
-    } else if (isDirectory(src)) {
-        // If the destination path has a same name file (not directory), throw exception.
-        if (isFile(dst))
-            throw Exception(_fmt("The destination path contains same name file. \"{}\" -> \"{}\"", src, dst));
-    } else {
-        throw Exception(_fmt("The specified path not exists. \"{}\"", src));
+    // @brief The file refers to the read-only region.
+    File(const String& name, std::shared_ptr<const _MappedRegion> region) : map_(std::move(region))
+    {
+        setName(name);
     }
 
-    deletes(dst);
-
-    // Create the parent directory of the destination path first if not exists.
-    if (!isDirectory(parentPath(dst)))
-        createDirectorys(parentPath(dst));
+    // @return If the data is read from the file of the path (it is mapped, or not loaded by LoadMode::LAZY),
+    // the path can't be written in place.
+    bool isBackedBy_(const String& path) const
+    {
+        if (!isLoaded()) {
+            std::error_code ec;
+            return isSameFileSystemEntity(diskPath_, path, ec);
+        }
 
-    if (isFile(src))
-        fs::create_symlink(src, dst);
-    else if (isDirectory(src))
-        fs::create_directory_symlink(src, dst);
-}
+        if (!map_ || !map_->isMapped())
+            return false;
 
-BTF_API String symlinkTarget(const String& path)
-{
-    return fs::read_symlink(path).string();
-}
+        Entry entry(path);
+        return entry.isFile() && map_->isMappingOf(entry.device(), entry.inode());
+    }
 
-BTF_API void createHardlink(const String& src, const String& dst, bool isOverwrite)
-{
-    // If the source path equals the destination path, do nothing.
-    if (isEqualPath(src, dst))
-        return;
+    // @brief Lock the file if it is loaded by LoadMode::LAZY (it has the disk path). Its data is read by the
+    // first const access, so the const accesses of it are serialized, and they are safe to be called
+    // concurrently same as the other files. The mutexes are shared by the files (striped by the address).
+    std::unique_lock<std::mutex> lockLazy_() const
+    {
+        if (diskPath_.empty())
+            return std::unique_lock<std::mutex>();
 
-    if (isFile(src)) {
-        if (!isOverwrite && isExists(dst))
-            return;
+        static std::mutex mutexes[64];
+        return std::unique_lock<std::mutex>(mutexes[reinterpret_cast<uintptr_t>(this) / alignof(File) % 64]);
+    }
 
-        // If the destination path has a same name directory (not file), throw exception.
-        if (isDirectory(dst))
-            throw Exception(_fmt("The destination path contains same name directory. \"{}\" -> \"{}\"", src, dst));
+    // @brief Read the data from disk if the file is loaded by LoadMode::LAZY and not loaded yet.
+    void load_() const
+    {
+        auto lock = lockLazy_();
 
-        deletes(dst);
+        if (data_ != nullptr || map_ != nullptr || diskPath_.empty())
+            return;
 
-        // Create the parent directory of the destination path first if not exists.
-        if (!isDirectory(parentPath(dst)))
-            createDirectorys(parentPath(dst));
+        File file = File::fromDiskPath(diskPath_, LoadMode::READ);
 
-        fs::create_hard_link(src, dst);
-    } else if (isDirectory(src)) {
-        throw Exception(_fmt("Can't hardlink for directory. \"{}\"", src));
-    } else {
-        throw Exception(_fmt("The specified path not exists. \"{}\"", src));
+        data_ = std::move(file.data_);
     }
-}
 
-BTF_API size_t hardlinkCount(const String& path)
-{
-    return fs::hard_link_count(path);
-}
-
-BTF_API String tempDirectory()
-{
-    return fs::temp_directory_path().string();
-}
+    // @brief Release the data and unlink the file from disk.
+    void reset_()
+    {
+        releaseData();
 
-// @return The pair of files and directorys.
-BTF_API std::pair<Strings, Strings>
-getAlls(const String& path, bool isRecursive, bool (*filter)(const String&))
-{
-    if (!isDirectory(path))
-        throw Exception(_fmt("The specified path is not directory or not exists. \"{}\"", path));
+        diskPath_.clear();
+        diskSize_ = 0;
+    }
 
-    Strings files;
-    Strings dirs;
+    // @brief Make sure the data is an owned buffer before modify it, the shared or mapped data
+    // is copied to the owned buffer and the file is unlinked from disk.
+    void detach_()
+    {
+        load_();
 
-    if (isRecursive) {
-        for (const auto& var : fs::recursive_directory_iterator(path)) {
-            String _path = var.path().string();
+        diskPath_.clear();
+        diskSize_ = 0;
 
-            if (var.is_regular_file() && (filter == nullptr || filter(_path)))
-                files.push_back(_path);
+        if (data_) {
+            if (data_.use_count() > 1)
+                data_ = std::make_shared<String>(*data_);
 
-            if (var.is_directory() && (filter == nullptr || filter(_path)))
-                dirs.push_back(_path);
+            // The reads of the buffer by the released owners happen before the writes.
+            std::atomic_thread_fence(std::memory_order_acquire);
+            return;
         }
-    } else {
-        for (const auto& var : fs::directory_iterator(path)) {
-            String _path = var.path().string();
-
-            if (var.is_regular_file() && (filter == nullptr || filter(_path)))
-                files.push_back(_path);
 
-            if (var.is_directory() && (filter == nullptr || filter(_path)))
-                dirs.push_back(_path);
+        if (map_) {
+            data_ = std::make_shared<String>(map_->data(), map_->size());
+            map_.reset();
+        } else {
+            data_ = std::make_shared<String>();
         }
     }
 
-    return { files, dirs };
-}
+    String name_;
 
-BTF_API Strings getAllFiles(const String& path, bool isRecursive, bool (*filter)(const String&))
-{
-    if (!isDirectory(path))
-        throw Exception(_fmt("The specified path is not directory or not exists. \"{}\"", path));
+    // The data is loaded when accessed if the file is loaded by LoadMode::LAZY,
+    // so it is mutable for the const accessors.
+    // The buffer is shared by the copies of the file, it is copied by #detach_ before modified.
+    mutable std::shared_ptr<String> data_;
+    mutable std::shared_ptr<const _MappedRegion> map_;
 
-    Strings files;
+    // The path and the size on disk of the file loaded by LoadMode::LAZY.
+    String diskPath_;
+    size_t diskSize_ = 0;
+};
 
-    if (isRecursive) {
-        for (const auto& var : fs::recursive_directory_iterator(path)) {
-            String _path = var.path().string();
+constexpr uint32_t _PACK_VERSION = 1;
+constexpr uint32_t _PACK_BYTE_ORDER = 0x01020304;
+constexpr uint32_t _PACK_ROOT = 0xFFFFFFFF;
 
-            if (var.is_regular_file() && (filter == nullptr || filter(_path)))
-                files.push_back(_path);
-        }
-    } else {
-        for (const auto& var : fs::directory_iterator(path)) {
-            String _path = var.path().string();
+// The header of the pack file, it is followed by the data of files, the entries and the strings.
+struct _PackHeader
+{
+    char magic[8];              // "BTFPACK\0".
+    uint32_t version;
+    uint32_t byteOrder;         // The #_PACK_BYTE_ORDER in the byte order of the writer.
+    uint64_t fileSize;
+    uint64_t entryOffset;
+    uint64_t entryCount;
+    uint64_t stringOffset;
+    uint64_t stringSize;
+    uint64_t rootNameSize;      // The name of the root directory is at the begin of the strings.
+    uint64_t indexChecksum;     // The checksum of the entries and the strings.
+    uint64_t headerChecksum;    // The checksum of the fields above.
+};
 
-            if (var.is_regular_file() && (filter == nullptr || filter(_path)))
-                files.push_back(_path);
-        }
-    }
+// The entry of a file or directory in the pack, the entries are sorted by the path.
+struct _PackEntry
+{
+    uint64_t offset;            // The offset of the data of file in the pack.
+    uint64_t size;
+    uint64_t checksum;          // The checksum of the data of file.
+    uint64_t pathOffset;        // The offset of the path (relative to the root, separated by '/') in the strings.
+    uint32_t pathSize;
+    uint32_t nameOffset;        // The offset of the name in the path.
+    uint32_t parent;            // The index of the entry of the parent directory, or #_PACK_ROOT.
+    uint32_t type;              // The #EntryType.
+};
 
-    return files;
-}
+class Dir;
 
-BTF_API Strings getAllDirectorys(const String& path, bool isRecursive, bool (*filter)(const String&))
+// @brief The reader of the single-file pack written by #Dir::writePack.
+// The pack is mapped (or read once if the platform not supports), the lookup by path is O(log n)
+// and the data of files are not copied (same as LoadMode::MMAP).
+// @note The layout is the header, the data of all files, the entries sorted by path and the strings.
+// The header and the index are verified when opened, the data of each file has its checksum.
+class Pack
 {
-    if (!isDirectory(path))
-        throw Exception(_fmt("The specified path is not directory or not exists. \"{}\"", path));
+public:
+    // @param isVerify If true, verify the checksums of the data of all files, else only the header
+    // and the index are verified (the data can be verified by #verify later).
+    // @throw If the pack is corrupted or its version is not supported.
+    explicit Pack(const String& path, bool isVerify = false) : path_(path)
+    {
+        region_ = _MappedRegion::map(path, LoadMode::MMAP);
 
-    Strings dirs;
+        if (region_ == nullptr) {
+            std::ifstream ifs(path, std::ios_base::binary);
 
-    if (isRecursive) {
-        for (const auto& var : fs::recursive_directory_iterator(path)) {
-            String _path = var.path().string();
+            if (!ifs.is_open())
+                throw Exception(_fmt("Failed to open the file: \"{}\"", path));
 
-            if (var.is_directory() && (filter == nullptr || filter(_path)))
-                dirs.push_back(_path);
-        }
-    } else {
-        for (const auto& var : fs::directory_iterator(path)) {
-            String _path = var.path().string();
+            auto arena = std::make_shared<Arena>();
+            size_t size = sizes(path);
+            char* data = static_cast<char*>(arena->allocate(size));
 
-            if (var.is_directory() && (filter == nullptr || filter(_path)))
-                dirs.push_back(_path);
+            ifs.read(data, size);
+            region_ = _MappedRegion::fromArena(arena, data, static_cast<size_t>(ifs.gcount()));
         }
-    }
-
-    return dirs;
-}
-
-#endif // !BTF_FWD
 
-} // namespace btf
+        validate_();
 
-// Classes.
-namespace btf
-{
+        if (isVerify && !verify())
+            throw Exception(_fmt("The pack file is corrupted: \"{}\" (the data checksum mismatch)", path_));
+    }
 
-#ifndef BTF_IMPL
+    const String& path() const { return path_; }
 
-class File
-{
-public:
-    File() = default;
+    // @return The name of the root directory.
+    const String& name() const { return name_; }
 
-    explicit File(const String& name) { setName(name); }
+    // @return The number of files and directories (exclude the root).
+    size_t entryCount() const { return static_cast<size_t>(header_->entryCount); }
 
-    File(const File& other)
+    // @param path The path relative to the root, separated by '/' or '\'.
+    bool hasFile(const String& path) const
     {
-        name_ = other.name_;
+        size_t pos = find_(path);
+        return pos != NOF_ && entries_[pos].type == static_cast<uint32_t>(EntryType::FILE);
+    }
 
-        if (other.data_)
-            data_ = new String(*other.data_);
+    // @param path The path relative to the root, separated by '/' or '\', the empty path is the root.
+    bool hasDir(const String& path) const
+    {
+        size_t pos = find_(path);
+        return pos == ROOT_ || (pos != NOF_ && entries_[pos].type == static_cast<uint32_t>(EntryType::DIRECTORY));
     }
 
-    File(File&& other) noexcept
+    // @return The file refers to the data in the pack without copy.
+    // @param path The path relative to the root, separated by '/' or '\'.
+    File file(const String& path) const
     {
-        name_ = other.name_;
+        size_t pos = find_(path);
 
-        data_ = other.data_;
-        other.data_ = nullptr;
-    }
+        if (pos == NOF_ || pos == ROOT_ || entries_[pos].type != static_cast<uint32_t>(EntryType::FILE))
+            throw Exception(_fmt("The file not exists in the pack. \"{}\" ({})", path, path_));
 
-    ~File() { releaseData(); }
+        const _PackEntry& entry = entries_[pos];
+        Vec<std::pair<size_t, size_t>> ranges(1, std::make_pair(static_cast<size_t>(entry.offset),
+                                                                static_cast<size_t>(entry.size)));
+        auto regions = _MappedRegion::slice(region_, ranges);
 
-    static File fromDiskPath(const String& filename)
-    {
-        std::ifstream ifs(filename, std::ios_base::binary);
+        return File(entryName_(pos), std::move(regions[0]));
+    }
 
-        if (!ifs.is_open())
-            throw Exception(_fmt("Failed to open the file: \"{}\"", filename));
+    // @return If the checksums of the data of all files are matched return true.
+    bool verify() const
+    {
+        for (size_t i = 0; i < entryCount(); ++i) {
+            const _PackEntry& entry = entries_[i];
 
-        File file(filenameEx(filename));
-        file << ifs;
+            if (entry.type != static_cast<uint32_t>(EntryType::FILE))
+                continue;
 
-        ifs.close();
+            if (_xxh64(region_->data() + entry.offset, entry.size) != entry.checksum)
+                return false;
+        }
 
-        return file;
+        return true;
     }
 
-    String name() const { return name_; }
+private:
+    friend class Dir;
+
+    static constexpr size_t NOF_ = size_t(-1);
+    static constexpr size_t ROOT_ = size_t(-2);
 
-    String data() const
+    // @brief Compare the path of the entry with the path.
+    int compare_(size_t pos, const char* path, size_t size) const
     {
-        if (data_ == nullptr)
-            return "";
-        return *data_;
+        const _PackEntry& entry = entries_[pos];
+        const char* entryPath = strings_ + entry.pathOffset;
+
+        int result = std::memcmp(entryPath, path, std::min<size_t>(entry.pathSize, size));
+        if (result != 0)
+            return result;
+
+        return entry.pathSize < size ? -1 : (entry.pathSize > size ? 1 : 0);
     }
 
-    size_t size() const
+    String entryName_(size_t pos) const
     {
-        if (data_ == nullptr)
-            return 0;
-        return data_->size();
+        const _PackEntry& entry = entries_[pos];
+        return String(strings_ + entry.pathOffset + entry.nameOffset, entry.pathSize - entry.nameOffset);
     }
 
-    bool empty() const { return size() == 0; }
-
-    void setName(const String& name)
+    // @return The position of the entry by binary search, if the path is the root return ROOT_,
+    // if not exists return NOF_.
+    size_t find_(const String& path) const
     {
-        if (!isValidFilename(name))
-            throw Exception(_fmt("Invalid file name: \"{}\"", name));
+        String key = path;
+        std::replace(key.begin(), key.end(), '\\', '/');
 
-        name_ = name;
-    }
+        size_t begin = key.find_first_not_of('/');
+        if (begin == String::npos)
+            return ROOT_;
 
-    void releaseData()
-    {
-        if (data_ == nullptr)
-            return;
+        size_t end = key.find_last_not_of('/') + 1;
 
-        delete data_;
-        data_ = nullptr;
-    }
+        size_t low = 0;
+        size_t high = entryCount();
+        while (low < high) {
+            size_t mid = low + (high - low) / 2;
+            int result = compare_(mid, key.data() + begin, end - begin);
 
-    void write(std::ostream& os) const
-    {
-        if (data_ == nullptr)
-            return;
+            if (result == 0)
+                return mid;
+
+            if (result < 0)
+                low = mid + 1;
+            else
+                high = mid;
+        }
 
-        os << *data_;
+        return NOF_;
     }
 
-    void write(const String& path, bool isOverwrite = false,
-               std::ios_base::openmode openmode = std::ios_base::binary) const
+    // @brief Verify the header and the index (include the bounds and the order of entries).
+    void validate_()
     {
-        String _path = path + PREFERRED_PATH_SEPARATOR + name_;
+        const char* data = region_->data();
+        size_t size = region_->size();
 
-        if (!isOverwrite && isFile(_path))
-            return;
+        auto corrupted = [&](const char* reason) {
+            return Exception(_fmt("The pack file is corrupted: \"{}\" ({})", path_, reason));
+        };
 
-        std::ofstream ofs(_path.data(), openmode);
+        if (size < sizeof(_PackHeader))
+            throw corrupted("too small");
 
-        if (!ofs.is_open())
-            throw Exception(_fmt("Failed to open the file: \"{}\"", _path));
+        header_ = reinterpret_cast<const _PackHeader*>(data);
 
-        write(ofs);
+        if (std::memcmp(header_->magic, "BTFPACK", 8) != 0)
+            throw corrupted("not a pack");
 
-        ofs.close();
+        if (header_->byteOrder != _PACK_BYTE_ORDER)
+            throw Exception(_fmt("The byte order of the pack file is not supported: \"{}\"", path_));
+
+        if (header_->version != _PACK_VERSION)
+            throw Exception(_fmt("The version of the pack file is not supported: \"{}\" ({})", path_,
+                                 header_->version));
+
+        if (_xxh64(header_, offsetof(_PackHeader, headerChecksum)) != header_->headerChecksum)
+            throw corrupted("the header checksum mismatch");
+
+        if (header_->fileSize != size || header_->entryOffset % alignof(_PackEntry) != 0 ||
+            header_->entryOffset > size || header_->entryCount > (size - header_->entryOffset) / sizeof(_PackEntry) ||
+            header_->stringOffset > size || header_->stringSize > size - header_->stringOffset ||
+            header_->rootNameSize > header_->stringSize || header_->entryCount >= _PACK_ROOT)
+            throw corrupted("the index out of bounds");
+
+        entries_ = reinterpret_cast<const _PackEntry*>(data + header_->entryOffset);
+        strings_ = data + header_->stringOffset;
+
+        uint64_t checksum = _xxh64(entries_, entryCount() * sizeof(_PackEntry));
+        if (_xxh64(strings_, header_->stringSize, checksum) != header_->indexChecksum)
+            throw corrupted("the index checksum mismatch");
+
+        for (size_t i = 0; i < entryCount(); ++i) {
+            const _PackEntry& entry = entries_[i];
+
+            bool isValid = entry.pathOffset <= header_->stringSize &&
+                           entry.pathSize <= header_->stringSize - entry.pathOffset &&
+                           entry.nameOffset < entry.pathSize &&
+                           (entry.parent == _PACK_ROOT || (entry.parent < i &&
+                            entries_[entry.parent].type == static_cast<uint32_t>(EntryType::DIRECTORY)));
+
+            if (entry.type == static_cast<uint32_t>(EntryType::FILE))
+                isValid = isValid && entry.offset <= size && entry.size <= size - entry.offset;
+            else if (entry.type != static_cast<uint32_t>(EntryType::DIRECTORY))
+                isValid = false;
+
+            // The binary search needs the strict order.
+            if (isValid && i > 0) {
+                const _PackEntry& prev = entries_[i - 1];
+                isValid = compare_(i, strings_ + prev.pathOffset, prev.pathSize) > 0;
+            }
+
+            if (!isValid)
+                throw corrupted("the entry is invalid");
+        }
+
+        name_ = String(strings_, header_->rootNameSize);
     }
 
-    File copy() const { return File(*this); }
+    String path_;
+    String name_;
+    std::shared_ptr<const _MappedRegion> region_;
+    const _PackHeader* header_ = nullptr;
+    const _PackEntry* entries_ = nullptr;
+    const char* strings_ = nullptr;
+};
 
-    File& operator=(const File& other)
-    {
-        name_ = other.name_;
+// @brief The open-addressing (linear probing) hash index of the children names of a directory.
+// The slots store the positions of the children plus one (zero is empty) and the hashes of their names,
+// so the names are not stored twice, and a lookup compares the name of the child directly.
+// If the children are reordered without the index (e.g. through #Dir::files), a lookup finds a slot
+// whose child has another name, then the index is stale.
+class _NameIndex
+{
+public:
+    // The children less than it are just scanned linearly.
+    static constexpr size_t THRESHOLD = 16;
 
-        releaseData();
+    static constexpr size_t NOF = size_t(-1);
 
-        if (other.data_)
-            data_ = new String(*other.data_);
+    // The index is found stale by the lookup.
+    static constexpr size_t STALE = size_t(-2);
 
-        return *this;
+    // @return If the index covers exactly the items.
+    template <typename T>
+    bool isValid(const Vec<T>& items) const
+    {
+        return count_ > 0 && count_ == items.size();
     }
 
-    File& operator=(const String& data)
+    // @return The position of the item which has the name, if not found return NOF.
+    // If the slot of the name refers to an item of another name, the index is stale, return STALE.
+    // @note The index must be valid for the items.
+    template <typename T>
+    size_t find(const Vec<T>& items, const String& name) const
     {
-        releaseData();
+        size_t mask = slots_.size() - 1;
+        size_t hash = hash_(name);
 
-        data_ = new String(data);
+        for (size_t i = hash & mask;; i = (i + 1) & mask) {
+            const Slot_& slot = slots_[i];
 
-        return *this;
+            if (slot.pos == 0)
+                return NOF;
+
+            if (slot.hash != hash)
+                continue;
+
+            const String& itemName = items[slot.pos - 1].name();
+
+            if (itemName == name)
+                return slot.pos - 1;
+
+            // Another name of same hash is a collision only if the item still has the hash of its slot.
+            if (hash_(itemName) != hash)
+                return STALE;
+        }
     }
 
+    // @brief Make the index cover the items, rebuild it if it is stale.
+    // If the items are less than the threshold the index is cleared.
     template <typename T>
-    File& operator=(const Vec<T>& data)
+    void sync(const Vec<T>& items)
     {
-        releaseData();
+        if (items.size() < THRESHOLD) {
+            clear();
+            return;
+        }
 
-        data_ = new String;
-        data_->reserve(data_->size() + data.size());
+        if (count_ != items.size())
+            rebuild(items);
+    }
 
-        for (const auto& var : data)
-            data_->push_back(var);
+    template <typename T>
+    void rebuild(const Vec<T>& items)
+    {
+        size_t capacity = 32;
+        while (capacity < items.size() * 2)
+            capacity *= 2;
 
-        return *this;
+        slots_.assign(capacity, Slot_());
+        for (size_t i = 0; i < items.size(); ++i)
+            insert_(hash_(items[i].name()), i);
+
+        count_ = items.size();
     }
 
-    File& operator<<(const File& other)
+    // @brief Update the index after an item is appended to the items.
+    template <typename T>
+    void push(const Vec<T>& items)
     {
-        if (data_ == nullptr)
-            data_ = new String;
-        data_->append(other.data());
+        // Keep the load factor no more than 0.5.
+        if (count_ == 0 || count_ + 1 != items.size() || items.size() * 2 > slots_.size()) {
+            sync(items);
+            return;
+        }
 
-        return *this;
+        insert_(hash_(items.back().name()), items.size() - 1);
+        ++count_;
     }
 
-    File& operator<<(std::istream& is)
+    // @brief Update the index before the item at the position is erased from the items,
+    // the positions after it are shifted down by one.
+    template <typename T>
+    void erase(const Vec<T>& items, size_t pos)
     {
-        is.seekg(0, std::ios_base::end);
-        size_t size = is.tellg();
-        is.seekg(0, std::ios_base::beg);
+        if (!isValid(items))
+            return;
+
+        if (items.size() - 1 < THRESHOLD) {
+            clear();
+            return;
+        }
+
+        size_t mask = slots_.size() - 1;
+
+        // The slot is found by the position, so it is right even if the other slots are stale.
+        size_t hole = hash_(items[pos].name()) & mask;
+        for (size_t i = 0; i < slots_.size() && slots_[hole].pos != pos + 1; ++i)
+            hole = (hole + 1) & mask;
+
+        if (slots_[hole].pos != pos + 1) {
+            clear();
+            return;
+        }
 
-        if (data_ == nullptr)
-            data_ = new String();
-        data_->reserve(data_->size() + size);
+        // Backward shift deletion, move the later entries of the probe chain to the hole.
+        for (size_t i = (hole + 1) & mask; slots_[i].pos != 0; i = (i + 1) & mask) {
+            size_t home = slots_[i].hash & mask;
 
-        char buffer[_BUFFER_SIZE] = {};
-        while (is.read(buffer, _BUFFER_SIZE))
-            data_->append(String(buffer, is.gcount()));
+            // Move the entry if its home is not in the cyclic range (hole, i].
+            bool isInRange = hole <= i ? (hole < home && home <= i) : (hole < home || home <= i);
+            if (!isInRange) {
+                slots_[hole] = slots_[i];
+                hole = i;
+            }
+        }
+        slots_[hole] = Slot_();
 
-        data_->append(String(buffer, is.gcount()));
+        for (auto& var : slots_) {
+            if (var.pos > pos + 1)
+                --var.pos;
+        }
 
-        return *this;
+        --count_;
     }
 
-    File& operator<<(const String& data)
+    void clear()
     {
-        if (data_ == nullptr)
-            data_ = new String();
-        data_->append(data);
-
-        return *this;
+        slots_.clear();
+        count_ = 0;
     }
 
-    template <typename T>
-    File& operator<<(const Vec<T>& data)
+private:
+    struct Slot_
     {
-        size_t size = data.size();
+        size_t pos = 0;     // The position of the item plus one, zero is empty.
+        size_t hash = 0;    // The hash of the name of the item when it is inserted.
+    };
 
-        if (data_ == nullptr)
-            data_ = new String;
-        data_->reserve(data_->size() + size);
+    static size_t hash_(const String& name) { return std::hash<String>()(name); }
 
-        for (const auto& var : data)
-            data_->push_back(var);
+    void insert_(size_t hash, size_t pos)
+    {
+        size_t mask = slots_.size() - 1;
 
-        return *this;
-    }
+        size_t i = hash & mask;
+        while (slots_[i].pos != 0)
+            i = (i + 1) & mask;
 
-    const File& operator>>(std::ostream& os) const
-    {
-        write(os);
-        return *this;
+        slots_[i].pos = pos + 1;
+        slots_[i].hash = hash;
     }
 
-private:
-    String name_;
-    String* data_ = nullptr;
+    Vec<Slot_> slots_;
+    size_t count_ = 0;
 };
 
 class Dir
@@ -1014,6 +7854,8 @@ public:
 
     explicit Dir(const String& name) { setName(name); }
 
+    // @note The data of files are shared until modified (see #File::File(const File&)),
+    // so the copy of the tree costs O(nodes) instead of O(bytes).
     Dir(const Dir& other)
     {
         name_ = other.name_;
@@ -1023,37 +7865,181 @@ public:
 
         if (other.subDirs_)
             subDirs_ = new Vec<Dir>(*other.subDirs_);
+
+        fileIndex_ = other.fileIndex_;
+        dirIndex_ = other.dirIndex_;
     }
 
     Dir(Dir&& other) noexcept
     {
-        name_ = other.name_;
+        name_ = std::move(other.name_);
 
         subFiles_ = other.subFiles_;
         other.subFiles_ = nullptr;
 
         subDirs_ = other.subDirs_;
         other.subDirs_ = nullptr;
+
+        fileIndex_ = std::move(other.fileIndex_);
+        other.fileIndex_.clear();
+
+        dirIndex_ = std::move(other.dirIndex_);
+        other.dirIndex_.clear();
     }
 
     ~Dir() { clear(); }
 
-    static Dir fromDiskPath(const String& dirpath)
+    // @param mode The mode to load the data of each file, see #File::fromDiskPath.
+    // @param backend If it is IoBackend::IO_URING and the mode is LoadMode::READ,
+    // the tree is scanned first and then all the files are read in batches.
+    static Dir fromDiskPath(const String& dirpath, LoadMode mode = LoadMode::READ,
+                            IoBackend backend = IoBackend::DEFAULT)
+    {
+        _BETTERFILE_SCOPE("Dir::fromDiskPath");
+
+        if (backend == IoBackend::IO_URING && mode == LoadMode::READ && isIoUringAvailable()) {
+            Dir root = scan_(dirpath);
+
+            Vec<File*> files;
+            Vec<_IoTask> tasks;
+            root.collectFiles_(dirpath, files, tasks);
+
+            Vec<String> datas(files.size());
+            for (size_t i = 0; i < files.size(); ++i)
+                tasks[i].out = &datas[i];
+
+            if (_runIoBatch(tasks)) {
+                for (size_t i = 0; i < files.size(); ++i)
+                    *files[i] = std::move(datas[i]);
+            } else {
+                for (size_t i = 0; i < files.size(); ++i)
+                    *files[i] = File::fromDiskPath(tasks[i].path);
+            }
+
+            return root;
+        }
+
+        Dir root(filenameEx(dirpath));
+
+        // Scan the directory once for both files and directories.
+        auto alls = getAlls(dirpath, false);
+        root.reserve_(alls.first.size(), alls.second.size());
+
+        for (const auto& var : alls.second)
+            root << Dir::fromDiskPath(var, mode);
+
+        for (const auto& var : alls.first)
+            root << File::fromDiskPath(var, mode);
+
+        return root;
+    }
+
+    // @brief Same as #fromDiskPath, and the data of files are placed in the arena, see
+    // #File::fromDiskPath(const String&, const std::shared_ptr<Arena>&). The tree refers to the arena,
+    // so the arena is released when the tree and all the copies of its files are released.
+    // @note Only the data is in the arena, the nodes and the names of the tree are allocated by the heap,
+    // so the arena saves the allocation of the data of each file, but the release of the tree is still O(nodes).
+    static Dir fromDiskPath(const String& dirpath, const std::shared_ptr<Arena>& arena)
+    {
+        _BETTERFILE_SCOPE("Dir::fromDiskPath");
+
+        Dir root(filenameEx(dirpath));
+
+        auto alls = getAlls(dirpath, false);
+        root.reserve_(alls.first.size(), alls.second.size());
+
+        for (const auto& var : alls.second)
+            root << Dir::fromDiskPath(var, arena);
+
+        for (const auto& var : alls.first)
+            root << File::fromDiskPath(var, arena);
+
+        return root;
+    }
+
+    // @brief Load the tree from the pack file written by #writePack, the data of files refer to the mapped pack
+    // without copy (same as LoadMode::MMAP), see #Pack.
+    // @param isVerify If true, verify the checksums of the data of all files, else only the header
+    // and the index are verified.
+    static Dir fromPack(const String& path, bool isVerify = false)
+    {
+        _BETTERFILE_SCOPE("Dir::fromPack");
+
+        Pack pack(path, isVerify);
+        size_t count = pack.entryCount();
+
+        // Count the children of each directory (the last is the root) first,
+        // so each vector is allocated once and the pointers to the children are stable.
+        Vec<std::pair<size_t, size_t>> counts(count + 1);
+        Vec<std::pair<size_t, size_t>> ranges;
+
+        for (size_t i = 0; i < count; ++i) {
+            const _PackEntry& entry = pack.entries_[i];
+            size_t parent = entry.parent == _PACK_ROOT ? count : entry.parent;
+
+            if (entry.type == static_cast<uint32_t>(EntryType::FILE)) {
+                ++counts[parent].first;
+                ranges.emplace_back(static_cast<size_t>(entry.offset), static_cast<size_t>(entry.size));
+            } else {
+                ++counts[parent].second;
+            }
+        }
+
+        auto regions = _MappedRegion::slice(pack.region_, ranges);
+
+        Dir root(pack.name());
+        root.reserve_(counts[count].first, counts[count].second);
+
+        // The parent is sorted before its children.
+        Vec<Dir*> dirs(count + 1);
+        dirs[count] = &root;
+
+        for (size_t i = 0, j = 0; i < count; ++i) {
+            const _PackEntry& entry = pack.entries_[i];
+            Dir* parent = dirs[entry.parent == _PACK_ROOT ? count : entry.parent];
+
+            if (entry.type == static_cast<uint32_t>(EntryType::FILE)) {
+                parent->subFiles_->emplace_back(File(pack.entryName_(i), std::move(regions[j++])));
+            } else {
+                parent->subDirs_->emplace_back(pack.entryName_(i));
+                dirs[i] = &parent->subDirs_->back();
+                dirs[i]->reserve_(counts[i].first, counts[i].second);
+            }
+        }
+
+        root.syncIndexes_();
+
+        return root;
+    }
+
+    // @brief Load the directory tree by a pool of workers, each directory is scanned by a task
+    // and each file is read by a task. The result is same as #fromDiskPath (include the order of children).
+    // @param threadCount The number of workers, 0 means the hardware concurrency.
+    // @param maxBytesInFlight The max total size of the files being read at the same time
+    // (a file larger than it is read alone).
+    // @param mode The mode to load the data of each file, see #File::fromDiskPath.
+    static Dir parallelFromDiskPath(const String& dirpath, uint threadCount = 0,
+                                    size_t maxBytesInFlight = 256 * 1024 * 1024, LoadMode mode = LoadMode::READ)
     {
+        _BETTERFILE_SCOPE("Dir::parallelFromDiskPath");
+
+        if (!isDirectory(dirpath))
+            throw Exception(_fmt("The specified path is not directory or not exists. \"{}\"", dirpath));
+
         Dir root(filenameEx(dirpath));
 
-        auto dirs = getAllDirectorys(dirpath, false);
-        for (const auto& var : dirs)
-            root << Dir::fromDiskPath(var);
+        _ByteBudget budget(maxBytesInFlight);
+        _WorkStealingPool pool(threadCount);
 
-        auto files = getAllFiles(dirpath, false);
-        for (const auto& var : files)
-            root << File::fromDiskPath(var);
+        pool.submit([&]() { load_(root, dirpath, mode, pool, budget); });
+        pool.wait();
+
+        root.syncIndexes_();
 
         return root;
     }
 
-    String name() const { return name_; }
+    const String& name() const { return name_; }
 
     size_t size() const
     {
@@ -1144,13 +8130,20 @@ public:
 
     const Vec<Dir>& dirs() const { return *subDirs_; }
 
+    // @note The name index is not updated by the modification through the returned vector. The reordered
+    // children are found by a linear scan until the index is rebuilt by the next non-const lookup, but don't
+    // rename (or replace) the children through it.
     Vec<File>& files() { return *subFiles_; }
 
+    // @note Same as #files.
     Vec<Dir>& dirs() { return *subDirs_; }
 
     File& file(const String& name)
     {
-        size_t pos = hasFile_(name);
+        if (subFiles_)
+            fileIndex_.sync(*subFiles_);
+
+        size_t pos = findAndRepair_(subFiles_, fileIndex_, name);
 
         if (pos == NOF_) {
             add(File(name));
@@ -1162,7 +8155,10 @@ public:
 
     Dir& dir(const String& name)
     {
-        size_t pos = hasDir_(name);
+        if (subDirs_)
+            dirIndex_.sync(*subDirs_);
+
+        size_t pos = findAndRepair_(subDirs_, dirIndex_, name);
 
         if (pos == NOF_) {
             add(Dir(name));
@@ -1174,21 +8170,23 @@ public:
 
     void removeFile(const String& name)
     {
-        size_t pos = hasFile_(name);
+        size_t pos = findAndRepair_(subFiles_, fileIndex_, name);
 
         if (pos == NOF_)
             return;
 
+        fileIndex_.erase(*subFiles_, pos);
         subFiles_->erase(subFiles_->begin() + pos);
     }
 
     void removeDir(const String& name)
     {
-        size_t pos = hasDir_(name);
+        size_t pos = findAndRepair_(subDirs_, dirIndex_, name);
 
         if (pos == NOF_)
             return;
 
+        dirIndex_.erase(*subDirs_, pos);
         subDirs_->erase(subDirs_->begin() + pos);
     }
 
@@ -1209,6 +8207,8 @@ public:
             delete subFiles_;
             subFiles_ = nullptr;
         }
+
+        fileIndex_.clear();
     }
 
     void clearDirs()
@@ -1217,6 +8217,8 @@ public:
             delete subDirs_;
             subDirs_ = nullptr;
         }
+
+        dirIndex_.clear();
     }
 
     void clear()
@@ -1230,7 +8232,9 @@ public:
         if (subFiles_ == nullptr)
             subFiles_ = new Vec<File>();
 
-        size_t pos = hasFile_(file.name());
+        fileIndex_.sync(*subFiles_);
+
+        size_t pos = findAndRepair_(subFiles_, fileIndex_, file.name());
 
         if (pos != NOF_) {
             if (isOverwrite)
@@ -1240,6 +8244,7 @@ public:
         }
 
         subFiles_->emplace_back(std::move(file));
+        fileIndex_.push(*subFiles_);
     }
 
     void add(Dir& dir, bool isOverwrite = false)
@@ -1247,7 +8252,9 @@ public:
         if (subDirs_ == nullptr)
             subDirs_ = new Vec<Dir>();
 
-        size_t pos = hasDir_(dir.name());
+        dirIndex_.sync(*subDirs_);
+
+        size_t pos = findAndRepair_(subDirs_, dirIndex_, dir.name());
 
         if (pos != NOF_) {
             if (isOverwrite)
@@ -1257,15 +8264,37 @@ public:
         }
 
         subDirs_->emplace_back(std::move(dir));
+        dirIndex_.push(*subDirs_);
     }
 
     void add(File&& file, bool isOverwrite = false) { add(file, isOverwrite); }
 
     void add(Dir&& dir, bool isOverwrite = false) { add(dir, isOverwrite); }
 
+    // @param backend If it is IoBackend::IO_URING and the openmode is binary,
+    // the directories are created first and then all the files are written in batches.
     void write(const String& path, bool isOverwrite = false,
-               std::ios_base::openmode openmode = std::ios_base::binary) const
+               std::ios_base::openmode openmode = std::ios_base::binary,
+               IoBackend backend = IoBackend::DEFAULT) const
     {
+        _BETTERFILE_SCOPE("Dir::write");
+
+        if (backend == IoBackend::IO_URING && openmode == std::ios_base::binary && isIoUringAvailable()) {
+            Vec<_IoTask> tasks;
+            prepareWrite_(path, isOverwrite, true, tasks);
+
+            if (!_runIoBatch(tasks)) {
+                for (const auto& var : tasks) {
+                    if (var.kind == _IoTask::COPY)
+                        copyFileData(var.path, var.dstPath);
+                    else
+                        writeFile(var.path, var.data, var.size);
+                }
+            }
+
+            return;
+        }
+
         String root = String(path) + PREFERRED_PATH_SEPARATOR + name_;
 
         createDirectory(root);
@@ -1279,10 +8308,164 @@ public:
                 var.write(root, isOverwrite);
     }
 
+    // @brief Write the tree by binary with the specified durability, see #WriteMode.
+    // If the mode is WriteMode::DURABLE, the files are flushed by groups (one syncfs per group)
+    // and each directory is flushed once, so it is crash safe without a fsync per file.
+    void write(const String& path, bool isOverwrite, WriteMode mode) const
+    {
+        _BETTERFILE_SCOPE("Dir::write");
+
+        if (mode == WriteMode::DEFAULT) {
+            write(path, isOverwrite);
+            return;
+        }
+
+        Vec<_IoTask> tasks;
+        prepareWrite_(path, isOverwrite, false, tasks);
+
+        // The parent has the entry of the root, and each directory has the entries of its children.
+        Strings dirs{path};
+        collectDirPaths_(path, dirs);
+
+        _commitWrites(tasks, dirs, mode == WriteMode::DURABLE);
+    }
+
+    // @brief Write the tree to a single pack file, it can be loaded by #fromPack or looked up by #Pack.
+    // @note The not loaded (LoadMode::LAZY) files are loaded to be written.
+    void writePack(const String& path) const
+    {
+        _BETTERFILE_SCOPE("Dir::writePack");
+
+        // The file is nullptr for the directory.
+        Vec<std::pair<String, const File*>> items;
+        collectPackItems_(String(), items);
+
+        std::sort(items.begin(), items.end(),
+                  [](const std::pair<String, const File*>& a, const std::pair<String, const File*>& b) {
+                      return a.first < b.first;
+                  });
+
+        if (items.size() >= _PACK_ROOT)
+            throw Exception(_fmt("Too many entries to pack: \"{}\"", path));
+
+        std::ofstream ofs(path, std::ios_base::binary | std::ios_base::trunc);
+
+        if (!ofs.is_open())
+            throw Exception(_fmt("Failed to open the file: \"{}\"", path));
+
+        // The header is written at last.
+        _PackHeader header;
+        std::memset(&header, 0, sizeof(header));
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        Vec<_PackEntry> entries(items.size());
+        String strings = name_;
+        uint64_t offset = sizeof(header);
+
+        for (size_t i = 0; i < items.size(); ++i) {
+            const String& itemPath = items[i].first;
+            _PackEntry& entry = entries[i];
+            size_t slash = itemPath.rfind('/');
+
+            entry.pathOffset = strings.size();
+            entry.pathSize = static_cast<uint32_t>(itemPath.size());
+            entry.nameOffset = slash == String::npos ? 0 : static_cast<uint32_t>(slash + 1);
+            entry.parent = _PACK_ROOT;
+            strings += itemPath;
+
+            // The parent is sorted before its children.
+            if (slash != String::npos) {
+                String parent = itemPath.substr(0, slash);
+                auto it = std::lower_bound(items.begin(), items.begin() + i, parent,
+                                           [](const std::pair<String, const File*>& a, const String& b) {
+                                               return a.first < b;
+                                           });
+                entry.parent = static_cast<uint32_t>(it - items.begin());
+            }
+
+            if (items[i].second) {
+                StringView view = items[i].second->dataView();
+
+                entry.type = static_cast<uint32_t>(EntryType::FILE);
+                entry.offset = offset;
+                entry.size = view.size();
+                entry.checksum = _xxh64(view.data(), view.size());
+
+                ofs.write(view.data(), view.size());
+                offset += view.size();
+            } else {
+                entry.type = static_cast<uint32_t>(EntryType::DIRECTORY);
+            }
+        }
+
+        // The entries are aligned, so they can be accessed in place when mapped.
+        size_t padding = static_cast<size_t>((alignof(_PackEntry) - offset % alignof(_PackEntry)) % alignof(_PackEntry));
+        ofs.write("\0\0\0\0\0\0\0\0", padding);
+        offset += padding;
+
+        std::memcpy(header.magic, "BTFPACK", 8);
+        header.version = _PACK_VERSION;
+        header.byteOrder = _PACK_BYTE_ORDER;
+        header.entryOffset = offset;
+        header.entryCount = entries.size();
+        header.stringOffset = offset + entries.size() * sizeof(_PackEntry);
+        header.stringSize = strings.size();
+        header.fileSize = header.stringOffset + header.stringSize;
+        header.rootNameSize = name_.size();
+        header.indexChecksum = _xxh64(strings.data(), strings.size(),
+                                      _xxh64(entries.data(), entries.size() * sizeof(_PackEntry)));
+        header.headerChecksum = _xxh64(&header, offsetof(_PackHeader, headerChecksum));
+
+        ofs.write(reinterpret_cast<const char*>(entries.data()), entries.size() * sizeof(_PackEntry));
+        ofs.write(strings.data(), strings.size());
+        ofs.seekp(0);
+        ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        ofs.close();
+
+        if (!ofs)
+            throw Exception(_fmt("Failed to write the file: \"{}\"", path));
+    }
+
+    // @brief Get the Merkle digest of the tree, see #btf::digest. The files are hashed by a pool of workers.
+    // @param threadCount The number of workers, 0 means the hardware concurrency.
+    // @param dirDigests If it is not null, it is filled with the digest of each directory (include the root),
+    // the key is the path relative to the parent of this directory.
+    uint64_t digest(uint threadCount = 0, std::map<String, uint64_t>* dirDigests = nullptr) const
+    {
+        _BETTERFILE_SCOPE("Dir::digest");
+
+        Vec<const File*> files;
+        collectHashFiles_(files);
+
+        // The files are hashed by batches, so the small files don't cost a task each.
+        Vec<uint64_t> hashes(files.size());
+
+        if (!files.empty()) {
+            _WorkStealingPool pool(threadCount);
+            size_t batch = std::max<size_t>(1, files.size() / (pool.threadCount() * 8));
+
+            for (size_t i = 0; i < files.size(); i += batch) {
+                size_t end = std::min(i + batch, files.size());
+                pool.submit([&files, &hashes, i, end]() {
+                    for (size_t j = i; j < end; ++j)
+                        hashes[j] = files[j]->hash();
+                });
+            }
+
+            pool.wait();
+        }
+
+        size_t pos = 0;
+        return digest_(hashes, pos, name_, dirDigests);
+    }
+
     Dir copy() const { return Dir(*this); }
 
     Dir& operator=(const Dir& other)
     {
+        if (this == &other)
+            return *this;
+
         name_ = other.name_;
 
         clear();
@@ -1293,6 +8476,33 @@ public:
         if (other.subDirs_)
             subDirs_ = new Vec<Dir>(*other.subDirs_);
 
+        fileIndex_ = other.fileIndex_;
+        dirIndex_ = other.dirIndex_;
+
+        return *this;
+    }
+
+    Dir& operator=(Dir&& other) noexcept
+    {
+        if (this == &other)
+            return *this;
+
+        name_ = std::move(other.name_);
+
+        clear();
+
+        subFiles_ = other.subFiles_;
+        other.subFiles_ = nullptr;
+
+        subDirs_ = other.subDirs_;
+        other.subDirs_ = nullptr;
+
+        fileIndex_ = std::move(other.fileIndex_);
+        other.fileIndex_.clear();
+
+        dirIndex_ = std::move(other.dirIndex_);
+        other.dirIndex_.clear();
+
         return *this;
     }
 
@@ -1327,33 +8537,254 @@ public:
 private:
     static constexpr size_t NOF_ = size_t(-1);
 
-    size_t hasFile_(const String& name) const
+    // @brief Scan the directory to the node, the children are allocated first and filled by the submitted tasks,
+    // so the order of children is same as the scan order.
+    static void load_(Dir& node, const String& dirpath, LoadMode mode, _WorkStealingPool& pool, _ByteBudget& budget)
+    {
+        auto alls = getAlls(dirpath, false);
+
+        if (!alls.second.empty()) {
+            node.subDirs_ = new Vec<Dir>(alls.second.size());
+
+            for (size_t i = 0; i < alls.second.size(); ++i) {
+                Dir* dir = &(*node.subDirs_)[i];
+                String path = alls.second[i];
+
+                dir->setName(filenameEx(path));
+                pool.submit([dir, path, mode, &pool, &budget]() { load_(*dir, path, mode, pool, budget); });
+            }
+        }
+
+        if (!alls.first.empty()) {
+            node.subFiles_ = new Vec<File>(alls.first.size());
+
+            for (size_t i = 0; i < alls.first.size(); ++i) {
+                File* file = &(*node.subFiles_)[i];
+                String path = alls.first[i];
+
+                pool.submit([file, path, mode, &budget]() {
+                    // The mapped file is not read, so it is not limited.
+                    bool isRead = mode == LoadMode::READ || mode == LoadMode::DIRECT;
+                    size_t size = isRead ? sizes(path) : 0;
+
+                    _ByteBudget::Guard guard(budget, size);
+                    *file = File::fromDiskPath(path, mode);
+                });
+            }
+        }
+    }
+
+    // @brief Scan the directory tree without the data of files.
+    static Dir scan_(const String& dirpath)
+    {
+        Dir root(filenameEx(dirpath));
+
+        auto alls = getAlls(dirpath, false);
+        root.reserve_(alls.first.size(), alls.second.size());
+
+        for (const auto& var : alls.second)
+            root << scan_(var);
+
+        for (const auto& var : alls.first)
+            root << File(filenameEx(var));
+
+        return root;
+    }
+
+    // @brief Collect the files of the whole tree and the read tasks of them.
+    void collectFiles_(const String& dirpath, Vec<File*>& files, Vec<_IoTask>& tasks)
     {
         if (subFiles_) {
-            for (size_t i = 0; i < subFiles_->size(); ++i) {
-                if ((*subFiles_)[i].name() == name)
-                    return i;
+            for (auto& var : *subFiles_) {
+                _IoTask task;
+                task.kind = _IoTask::READ;
+                task.path = dirpath + PREFERRED_PATH_SEPARATOR + var.name();
+
+                files.push_back(&var);
+                tasks.emplace_back(std::move(task));
             }
         }
 
-        return NOF_;
+        if (subDirs_)
+            for (auto& var : *subDirs_)
+                var.collectFiles_(dirpath + PREFERRED_PATH_SEPARATOR + var.name(), files, tasks);
+    }
+
+    // @brief Create the directories of the whole tree and collect the file writes by the rules of #File::write.
+    // The not loaded file is copied from disk, and the data of others must live until the tasks are done.
+    // @param isInPlace If true, the tasks write the files in place, so the files whose data is read from
+    // the destination itself are not collected, they are written by WriteMode::ATOMIC at once.
+    void prepareWrite_(const String& path, bool isOverwrite, bool isInPlace, Vec<_IoTask>& tasks) const
+    {
+        String root = String(path) + PREFERRED_PATH_SEPARATOR + name_;
+
+        createDirectory(root);
+
+        if (subFiles_) {
+            for (const auto& var : *subFiles_) {
+                _IoTask task;
+                task.path = root + PREFERRED_PATH_SEPARATOR + var.name();
+
+                if (!isOverwrite && isFile(task.path))
+                    continue;
+
+                if (isInPlace && var.isBackedBy_(task.path)) {
+                    var.write(root, true, WriteMode::ATOMIC);
+                    continue;
+                }
+
+                if (var.isLoaded()) {
+                    task.kind = _IoTask::WRITE;
+                    task.data = var.cdata();
+                    task.size = var.size();
+                } else {
+                    task.kind = _IoTask::COPY;
+                    task.dstPath = std::move(task.path);
+                    task.path = var.diskPath();
+                }
+
+                tasks.emplace_back(std::move(task));
+            }
+        }
+
+        if (subDirs_)
+            for (const auto& var : *subDirs_)
+                var.prepareWrite_(root, isOverwrite, isInPlace, tasks);
+    }
+
+    void collectDirPaths_(const String& path, Strings& dirs) const
+    {
+        String root = path + PREFERRED_PATH_SEPARATOR + name_;
+        dirs.push_back(root);
+
+        if (subDirs_)
+            for (const auto& var : *subDirs_)
+                var.collectDirPaths_(root, dirs);
+    }
+
+    // @brief Collect the files in the order of #digest_.
+    void collectHashFiles_(Vec<const File*>& files) const
+    {
+        if (subFiles_)
+            for (const auto& var : *subFiles_)
+                files.push_back(&var);
+
+        if (subDirs_)
+            for (const auto& var : *subDirs_)
+                var.collectHashFiles_(files);
     }
 
-    size_t hasDir_(const String& name) const
+    uint64_t digest_(const Vec<uint64_t>& hashes, size_t& pos, const String& path,
+                     std::map<String, uint64_t>* dirDigests) const
     {
+        Vec<_MerkleEntry> entries;
+
+        if (subFiles_)
+            for (const auto& var : *subFiles_)
+                entries.push_back(_MerkleEntry{&var.name(), false, hashes[pos++]});
+
+        if (subDirs_)
+            for (const auto& var : *subDirs_)
+                entries.push_back(
+                    _MerkleEntry{&var.name_, true, var.digest_(hashes, pos, pathcat(path, var.name_), dirDigests)});
+
+        uint64_t hash = _merkleHash(entries);
+
+        if (dirDigests)
+            (*dirDigests)[path] = hash;
+
+        return hash;
+    }
+
+    // @brief Collect the paths (relative to the tree, separated by '/') of the whole tree for #writePack.
+    void collectPackItems_(const String& prefix, Vec<std::pair<String, const File*>>& items) const
+    {
+        if (subFiles_)
+            for (const auto& var : *subFiles_)
+                items.emplace_back(prefix + var.name(), &var);
+
         if (subDirs_) {
-            for (size_t i = 0; i < subDirs_->size(); ++i) {
-                if ((*subDirs_)[i].name() == name)
-                    return i;
+            for (const auto& var : *subDirs_) {
+                items.emplace_back(prefix + var.name(), nullptr);
+                var.collectPackItems_(prefix + var.name() + '/', items);
             }
         }
+    }
+
+    // @brief Reserve the children, so the vectors are allocated once when the sizes are known.
+    void reserve_(size_t fileCount, size_t dirCount)
+    {
+        if (fileCount > 0) {
+            if (subFiles_ == nullptr)
+                subFiles_ = new Vec<File>();
+            subFiles_->reserve(fileCount);
+        }
+
+        if (dirCount > 0) {
+            if (subDirs_ == nullptr)
+                subDirs_ = new Vec<Dir>();
+            subDirs_->reserve(dirCount);
+        }
+    }
+
+    // @brief Build the name indexes of the whole tree after the children are filled directly.
+    void syncIndexes_()
+    {
+        if (subFiles_)
+            fileIndex_.sync(*subFiles_);
+
+        if (subDirs_) {
+            dirIndex_.sync(*subDirs_);
+
+            for (auto& var : *subDirs_)
+                var.syncIndexes_();
+        }
+    }
+
+    // @brief Find the child by the name index if it is valid, else (or if the index is found stale,
+    // e.g. the children are reordered through #files) scan linearly.
+    template <typename T>
+    static size_t find_(const Vec<T>* items, const _NameIndex& index, const String& name)
+    {
+        if (items == nullptr)
+            return NOF_;
+
+        if (index.isValid(*items)) {
+            size_t pos = index.find(*items, name);
+            if (pos != _NameIndex::STALE)
+                return pos;
+        }
+
+        for (size_t i = 0; i < items->size(); ++i) {
+            if ((*items)[i].name() == name)
+                return i;
+        }
 
         return NOF_;
     }
 
+    // @brief Same as #find_, and the index is rebuilt if it is found stale, so the later lookups use it again.
+    template <typename T>
+    static size_t findAndRepair_(const Vec<T>* items, _NameIndex& index, const String& name)
+    {
+        if (items != nullptr && index.isValid(*items) && index.find(*items, name) == _NameIndex::STALE)
+            index.rebuild(*items);
+
+        return find_(items, index, name);
+    }
+
+    size_t hasFile_(const String& name) const { return find_(subFiles_, fileIndex_, name); }
+
+    size_t hasDir_(const String& name) const { return find_(subDirs_, dirIndex_, name); }
+
     String name_;
     Vec<File>* subFiles_ = nullptr;
     Vec<Dir>* subDirs_ = nullptr;
+
+    // The name indexes are only updated by the non-const methods,
+    // so the const lookups are safe to be called concurrently.
+    _NameIndex fileIndex_;
+    _NameIndex dirIndex_;
 };
 
 #endif // !BTF_IMPL